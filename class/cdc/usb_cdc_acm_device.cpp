@@ -11,6 +11,7 @@
 // use library for USB host/device functionality.
 // (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
 //
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -34,6 +35,7 @@ usb_cdc_acm_device::usb_cdc_acm_device(
   interface_association(_assoc),
   interface_control(_if_ctrl),
   interface_data(_if_data),
+ _controller(controller),
  _configuration(configuration)
 {
     TUPP_LOG(LOG_DEBUG, "usb_cdc_acm_device() @%x", this);
@@ -82,7 +84,7 @@ usb_cdc_acm_device::usb_cdc_acm_device(
 
     // Prepare new request to receive data
     //////////////////////////////////////
-    _ep_data_out->start_transfer(_buffer_out, _ep_data_out->descriptor.wMaxPacketSize);
+    start_receive();
 
     // Endpoint handlers
     ////////////////////
@@ -91,31 +93,42 @@ usb_cdc_acm_device::usb_cdc_acm_device(
         if (_received_data.available_put() < (2 * _ep_data_out->descriptor.wMaxPacketSize)) {
             _ep_data_out->send_NAK(true);
         }
-        // Copy all available bytes to the fifo
-        for (int i=0; i < len; ++i) {
-            bool b = _received_data.put(buf[i]);
-            assert(b);
+        if (buf == _buffer_out) {
+            // Copy all received bytes to the fifo
+            int n = _received_data.put_n(buf, len);
+            assert(n == len);
+            (void)n;
+        } else {
+            // Data has been received directly into the fifo
+            _received_data.commit_write(len);
         }
         // Call user handler if existing
         if (received_handler) {
             received_handler();
         }
         // Trigger a new reception
-        _ep_data_out->start_transfer(_buffer_out, _ep_data_out->descriptor.wMaxPacketSize);
+        start_receive();
     };
 
     _ep_data_in->data_handler = [&](uint8_t *, uint16_t len) {
-        // Value of len is discarded, use it as a local variable!
-        // Try to send as much data as possible up to MaxPacketSize
-        for(len = 0; len < _ep_data_in->descriptor.wMaxPacketSize; ++len) {
-            if (!_data_to_transmit.get(_buffer_in[len])) {
-                break;
-            }
-        }
-        // Trigger a new transmit if we have sent something before
-        // (which might indicate there is more data to sent...)
-        if (len) {
-            _ep_data_in->start_transfer(_buffer_in, len);
+        // Data which has been sent directly from the fifo
+        // is released now. A call with len == 0 just
+        // triggers a new transfer.
+        _data_to_transmit.consume(len);
+        // Try to send as much data as possible up to MaxPacketSize.
+        // If the data is wrapped around in the fifo, both parts are
+        // sent in one packet (scatter-gather transfer).
+        uint16_t mps = _ep_data_in->descriptor.wMaxPacketSize;
+        std::span<uint8_t> first, second;
+        if (_data_to_transmit.peek_read(first, second)) {
+            uint16_t len1 = std::min<size_t>(first.size(), mps);
+            uint16_t room = mps - len1;
+            uint16_t len2 = std::min<size_t>(second.size(), room);
+            usb_endpoint::segment_t segments[2] {
+                { first.data(),  len1 },
+                { second.data(), len2 }
+            };
+            _ep_data_in->start_transfer(std::span(segments, len2 ? 2 : 1));
         }
     };
 
@@ -179,31 +192,78 @@ usb_cdc_acm_device::usb_cdc_acm_device(
 }
 
 uint16_t usb_cdc_acm_device::read(uint8_t *buf, uint16_t max_len) {
-    uint8_t  val = 0;
-    uint16_t len;
-    for (len=0; len < max_len; ++len) {
-        if (_received_data.get(val)) {
-            buf[len] = val;
-        } else break;
-    }
-    // Check if we can receive more data
-    if (_received_data.available_get() < (2 * _ep_data_out->descriptor.wMaxPacketSize)) {
-        _ep_data_out->send_NAK(false);
-    }
+    uint16_t len = _received_data.get_n(buf, max_len);
+    check_receive();
     return len;
 }
 
+std::span<const uint8_t> usb_cdc_acm_device::peek_read() {
+    return _received_data.peek_read();
+}
+
+void usb_cdc_acm_device::consume(uint16_t n) {
+    _received_data.consume(n);
+    check_receive();
+}
+
 uint16_t usb_cdc_acm_device::available() {
     return _received_data.available_get();
 }
 
 uint32_t usb_cdc_acm_device::write(const uint8_t *buf, uint32_t len) {
-    uint32_t written = 0;
-    for(uint32_t i=0; i < len; ++i) {
-        if (_data_to_transmit.put(buf[i])) {
-            written++;
-        } else break;
+    // The FIFO can not take more than its size
+    if (len > TUPP_CDC_ACM_FIFO_SIZE) len = TUPP_CDC_ACM_FIFO_SIZE;
+    uint32_t written = _data_to_transmit.put_n(buf, len);
+    start_transmit();
+    return written;
+}
+
+std::span<uint8_t> usb_cdc_acm_device::reserve_write(uint16_t n) {
+    return _data_to_transmit.reserve_write(n);
+}
+
+void usb_cdc_acm_device::commit_write(uint16_t n) {
+    _data_to_transmit.commit_write(n);
+    start_transmit();
+}
+
+void usb_cdc_acm_device::start_receive() {
+    // Receive directly into the fifo if there is enough
+    // space for a complete packet. If the space is wrapped
+    // around, both parts are used (scatter-gather transfer).
+    // Otherwise use the internal buffer.
+    uint16_t mps = _ep_data_out->descriptor.wMaxPacketSize;
+    std::span<uint8_t> first, second;
+    if (_received_data.reserve_write(mps, first, second) == mps) {
+        usb_endpoint::segment_t segments[2] {
+            { first.data(),  (uint16_t)first.size()  },
+            { second.data(), (uint16_t)second.size() }
+        };
+        _ep_data_out->start_transfer(std::span(segments, second.empty() ? 1 : 2));
+    } else {
+        _ep_data_out->start_transfer(_buffer_out, mps);
+    }
+}
+
+void usb_cdc_acm_device::start_transmit() {
+#if TUPP_DUAL_CORE
+    if (!_start_transmit_queued.load()) {
+        _start_transmit_queued.store(true);
+        if (!_controller.call_on_usb_core(
+                delegate<void()>::bind<&usb_cdc_acm_device::start_transmit_usb>(this))) {
+            // Queue is full, so try again with the next call
+            _start_transmit_queued.store(false);
+        }
     }
+#else
+    start_transmit_usb();
+#endif
+}
+
+void usb_cdc_acm_device::start_transmit_usb() {
+    // Clear the flag before looking at the FIFO, so
+    // new data after this point queues a new call.
+    _start_transmit_queued.store(false);
     // Check if we need a new initial transfer
     // if the endpoint is currently not active
     if (!_ep_data_in->is_active()) {
@@ -211,7 +271,28 @@ uint32_t usb_cdc_acm_device::write(const uint8_t *buf, uint32_t len) {
         // looks at the FIFO to decide whether to send data!
         _ep_data_in->data_handler(nullptr, 0);
     }
-    return written;
+}
+
+void usb_cdc_acm_device::check_receive() {
+#if TUPP_DUAL_CORE
+    if (!_check_receive_queued.load()) {
+        _check_receive_queued.store(true);
+        if (!_controller.call_on_usb_core(
+                delegate<void()>::bind<&usb_cdc_acm_device::check_receive_usb>(this))) {
+            _check_receive_queued.store(false);
+        }
+    }
+#else
+    check_receive_usb();
+#endif
+}
+
+void usb_cdc_acm_device::check_receive_usb() {
+    _check_receive_queued.store(false);
+    // Check if we can receive more data
+    if (_received_data.available_get() < (2 * _ep_data_out->descriptor.wMaxPacketSize)) {
+        _ep_data_out->send_NAK(false);
+    }
 }
 
 bool usb_cdc_acm_device::notify_serial_state(const TUPP::CDC::bmUartState_t & state) {
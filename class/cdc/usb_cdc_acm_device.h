@@ -16,6 +16,10 @@
 // /dev/ttyACM[x] on Linux. The user interface are simple
 // read and write methods, plus some callback handlers
 // (see below).
+// In dual-core mode (TUPP_DUAL_CORE), the read and write
+// methods (including the zero-copy variants) may be called
+// on the other core. They only access the FIFOs, and the
+// endpoints are only touched on the USB core.
 //
 #ifndef TUPP_USB_CDC_ACM_DEVICE_H
 #define TUPP_USB_CDC_ACM_DEVICE_H
@@ -32,7 +36,9 @@
 #include "usb_fd_acm.h"
 #include "usb_fd_union.h"
 #include "usb_fifo.h"
-#include <functional>
+#include "usb_delegate.h"
+#include <atomic>
+#include <span>
 #include <utility>
 
 class usb_cdc_acm_device {
@@ -57,15 +63,31 @@ public:
     // 'len' bytes (with updated buf-pointer per call).
     uint32_t write(const uint8_t *buf, uint32_t len);
 
+    // Zero-copy access to the receive FIFO. peek_read()
+    // returns a contiguous span of received bytes, which
+    // stay in the FIFO until they are released with
+    // consume(). Data beyond the FIFO wrap-around is
+    // returned by the next call to peek_read().
+    std::span<const uint8_t> peek_read();
+    void consume(uint16_t n);
+
+    // Zero-copy access to the transmit FIFO. reserve_write()
+    // returns a contiguous span of up to n free bytes, which
+    // can be filled in place (it might be shorter than n).
+    // commit_write() hands over the first n bytes of this
+    // span for transmission.
+    std::span<uint8_t> reserve_write(uint16_t n);
+    void commit_write(uint16_t n);
+
     // Send a serial state notification to this device.
     bool notify_serial_state(const TUPP::CDC::bmUartState_t & state);
 
     // Callback handlers for UART format
-    std::function<void(const CDC::line_coding_t & lc)>  line_coding_handler;
-    std::function<void(bool dtr, bool rts)>             control_line_handler;
-    std::function<void(uint16_t millis)>                break_handler;
+    delegate<void(const CDC::line_coding_t & lc)>  line_coding_handler;
+    delegate<void(bool dtr, bool rts)>             control_line_handler;
+    delegate<void(uint16_t millis)>                break_handler;
     // Callback handler when data has been received
-    std::function<void()> received_handler;
+    delegate<void()> received_handler;
 
     // Set the function name
     inline void set_FunctionName(const char * n) {
@@ -84,6 +106,19 @@ public:
     char * line_coding_2_str();
 
 private:
+    // Prepare a new OUT transfer for received data
+    void start_receive();
+    // Start a new IN transfer if the endpoint is idle
+    void start_transmit();
+    // Accept new data if there is enough space again
+    void check_receive();
+    // The versions of the above methods, which run on
+    // the USB core (see TUPP_DUAL_CORE)
+    void start_transmit_usb();
+    void check_receive_usb();
+
+    usb_device_controller &     _controller;
+
     // CDC ACM descriptor tree
     usb_configuration &         _configuration;
     usb_interface_association   _assoc       {_configuration};
@@ -107,9 +142,16 @@ private:
     fifo<uint8_t, TUPP_CDC_ACM_FIFO_SIZE> _received_data;
     fifo<uint8_t, TUPP_CDC_ACM_FIFO_SIZE> _data_to_transmit;
 
-    // Internal data buffers
+    // Internal receive buffer. It is only used when the
+    // FIFO has no space for a complete packet. Otherwise
+    // the endpoints transfer the data directly from/to
+    // the FIFOs.
     uint8_t _buffer_out[TUPP_DEFAULT_PAKET_SIZE] {0};
-    uint8_t _buffer_in [TUPP_DEFAULT_PAKET_SIZE] {0};
+
+    // Calls to the USB core which are queued already.
+    // They are only queued once in dual-core mode.
+    std::atomic<bool>           _start_transmit_queued {false};
+    std::atomic<bool>           _check_receive_queued  {false};
 };
 
 #endif  // TUPP_USB_CDC_ACM_DEVICE_H
@@ -31,6 +31,7 @@ public:
     inline void set_bmCapabilities(TUPP::CDC::bmAcmCapabilities_t val) {
         TUPP_LOG(LOG_DEBUG, "set_bmCapabilities(0x%x)", val);
         _descriptor.bmCapabilities = val;
+        update_descriptor();
     }
 
 private:
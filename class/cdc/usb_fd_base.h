@@ -17,15 +17,15 @@
 #define TUPP_USB_FD_BASE_H
 
 #include <cstdint>
+#include "usb_interface.h"
 #include "usb_log.h"
 
 using enum usb_log::log_level;
-class usb_interface;
 
 class usb_fd_base {
 public:
     usb_fd_base(usb_interface & i, uint8_t * ptr, uint16_t len)
-    : descriptor(ptr), descriptor_length(len), next(nullptr), _parent(i) {
+    : descriptor(ptr), descriptor_length(len), next(nullptr), blob_offset(0), _parent(i) {
         TUPP_LOG(LOG_DEBUG, "usb_fd_base() @%x", this);
     }
 
@@ -40,7 +40,16 @@ public:
     // Pointer to the next functional descriptor or nullptr
     usb_fd_base * next;
 
+    // Offset in the serialized configuration descriptor
+    uint16_t blob_offset;
+
 protected:
+    // Patch our descriptor in the serialized
+    // configuration descriptor
+    inline void update_descriptor() {
+        _parent.patch_descriptor(blob_offset, descriptor, descriptor_length);
+    }
+
     // The parent interface of this functional descriptor
     usb_interface & _parent;
 };
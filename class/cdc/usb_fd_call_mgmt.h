@@ -31,10 +31,12 @@ public:
     inline void set_bmCapabilities(TUPP::CDC::bmCmCapabilities_t val) {
         TUPP_LOG(LOG_DEBUG, "set_bmCapabilities(0x%x)", val);
         _descriptor.bmCapabilities = val;
+        update_descriptor();
     }
     inline void set_bDataInterface(uint8_t val) {
         TUPP_LOG(LOG_DEBUG, "set_bDataInterface(%d)", val);
         _descriptor.bDataInterface = val;
+        update_descriptor();
     }
 
 private:
@@ -31,6 +31,7 @@ public:
     inline void set_bcdCDC(uint16_t val) {
         TUPP_LOG(LOG_DEBUG, "set_bcdCDC(%d)", val);
         _descriptor.bcdCDC = val;
+        update_descriptor();
     }
 
 private:
@@ -31,10 +31,12 @@ public:
     inline void set_bControlInterface(uint8_t val) {
         TUPP_LOG(LOG_DEBUG, "set_bControlInterface(%d)", val);
         _descriptor.bControlInterface = val;
+        update_descriptor();
     }
     inline void set_bSubordinateInterface0(uint8_t val) {
         TUPP_LOG(LOG_DEBUG, "set_bSubordinateInterface0(%d)", val);
         _descriptor.bSubordinateInterface[0] = val;
+        update_descriptor();
     }
 
 private:
@@ -44,28 +44,56 @@ usb_msc_bot_device::usb_msc_bot_device(
 
     // USB endpoints
     _ep_in  = controller.create_endpoint(_interface, DIR_IN,  TRANS_BULK);
+#if TUPP_MSC_DOUBLE_BUFFERED
+    _ep_in->set_double_buffered(true);
+#endif
     _ep_out = controller.create_endpoint(_interface, DIR_OUT, TRANS_BULK);
+#if TUPP_MSC_DOUBLE_BUFFERED
+    // The host always sends the announced number of bytes,
+    // so double-buffering can also be used for OUT.
+    _ep_out->set_double_buffered(true);
+#endif
 
     // Prepare new request to receive data
-    // Note: We can NOT receive larger blocks than TUPP_MSC_BLOCK_SIZE here,
-    // because a partial USB packet will not be detected. If we e.g. ask for
-    // 1024 bytes, but the device answers only with 512 bytes, we are at a
-    // clean 64-byte border and would wait for more packets, which would
-    // never be received.
-    _ep_out->start_transfer(_buffer_out, TUPP_MSC_BLOCK_SIZE);
+    receive_cbw();
 
     // Endpoint handler
     _ep_out->data_handler = [&](uint8_t *, uint16_t len) {
-        if (_buffer_out_len) {
+        uint8_t idx = _buffer_rx_idx;
+        if (_buffer_out_len[idx]) {
             TUPP_LOG(LOG_WARNING, "Unconsumed data!");
         }
-        // New data has arrived from the host! Stop incoming data ...
-        _ep_out->send_NAK(true);
-        // ... and set length to signal new data
-        _buffer_out_len = len;
-        // Finally trigger a new reception
-        _ep_out->start_transfer(_buffer_out, TUPP_MSC_BLOCK_SIZE);
+        _buffer_rx_idx = idx ^ 1;
+        // During a WRITE_10, receive the next blocks into the
+        // other buffer while these ones are written. If it has
+        // not been consumed yet, the data stage is paused, and
+        // the host receives NAKs until the state machine has
+        // released the buffer. A short transfer ends the data
+        // stage. Otherwise (e.g. for a CBW) the next reception
+        // is started by the state machine.
+        if (_state == state_t::DATA_WRITE &&
+            _blocks_requested < _blocks_to_transfer &&
+            len == _blocks_receiving[idx] * TUPP_MSC_BLOCK_SIZE) {
+            if (_buffer_out_len[idx ^ 1]) {
+                _rx_paused = true;
+            } else {
+                receive_blocks();
+            }
+        }
+        // New data has arrived from the host! Set
+        // length to signal new data.
+        _buffer_out_len[idx] = len;
+#if TUPP_DUAL_CORE
+        run_request();
+#endif
     };
+#if TUPP_DUAL_CORE
+    // A completed IN transfer might let the state machine
+    // continue (free IN buffer, or room for the CSW)
+    _ep_in->data_handler = [&](uint8_t *, uint16_t) {
+        run_request();
+    };
+#endif
 
     // Handler for MSC specific requests
     _interface.setup_handler = [&](TUPP::setup_packet_t *pkt) {
@@ -79,6 +107,15 @@ usb_msc_bot_device::usb_msc_bot_device(
                 // bits of the bulk EPs should not be touched. So
                 // we do NOT reset the bulk EPs here ...
                 _state = state_t::RECEIVE_CBW;
+                // Drop unconsumed data and make sure the
+                // next CBW can be received
+                if (!_ep_out->is_active()) {
+                    _buffer_out_len[0] = 0;
+                    _buffer_out_len[1] = 0;
+                    _buffer_out_idx = _buffer_rx_idx;
+                    _rx_paused = false;
+                    receive_cbw();
+                }
                 break;
             }
             case bRequest_t::REQ_MSC_GET_MAX_LUN: {
@@ -118,6 +155,40 @@ usb_msc_bot_device::usb_msc_bot_device(
 }
 
 
+void usb_msc_bot_device::receive_cbw() {
+    // A CBW is always shorter than the requested length,
+    // so the transfer ends with this short packet.
+    _ep_out->start_transfer(_buffer_out[_buffer_rx_idx], TUPP_MSC_BLOCK_SIZE);
+}
+
+void usb_msc_bot_device::receive_blocks() {
+    // Receive as many blocks as possible in one transfer.
+    // The host sends the announced number of bytes, so
+    // the transfer ends when all bytes have been received.
+    uint8_t  idx    = _buffer_rx_idx;
+    uint16_t blocks = _blocks_to_transfer - _blocks_requested;
+    if (blocks > TUPP_MSC_WRITE_BLOCKS) {
+        blocks = TUPP_MSC_WRITE_BLOCKS;
+    }
+    _blocks_receiving[idx] = blocks;
+    _blocks_requested      = _blocks_requested + blocks;
+    _ep_out->start_transfer(_buffer_out[idx], blocks * TUPP_MSC_BLOCK_SIZE);
+}
+
+void usb_msc_bot_device::resume_blocks() {
+    // The endpoint is idle while the data stage is paused,
+    // so the data handler does not access the flag now.
+    if (_rx_paused && !_buffer_out_len[_buffer_rx_idx]) {
+        _rx_paused = false;
+        receive_blocks();
+    }
+}
+
+void usb_msc_bot_device::release_buffer_out() {
+    _buffer_out_len[_buffer_out_idx] = 0;
+    _buffer_out_idx ^= 1;
+}
+
 void usb_msc_bot_device::scsi_success() {
     // Set sense keys
     _sense_fixed_response.sense_key         = SCSI::sense_key_t::NO_SENSE;
@@ -139,32 +210,48 @@ void usb_msc_bot_device::scsi_fail(SCSI::sense_key_t key, uint8_t code, uint8_t
 }
 
 
-// This method implements a simple state machine
-// according to the MSC BOT specification. This
-// method has to be called by the user program
-// in a tight loop (also in e.g. a RTOS thread).
 void usb_msc_bot_device::handle_request() {
+#if !TUPP_DUAL_CORE
+    process_request();
+#endif
+}
+
+void usb_msc_bot_device::run_request() {
+    state_t state;
+    do {
+        state = _state;
+        process_request();
+    } while (state != _state);
+}
+
+// This method implements a simple state machine
+// according to the MSC BOT specification. It is
+// called by the user program via handle_request()
+// in a tight loop (also in e.g. a RTOS thread), or
+// by the endpoint handlers in dual-core mode.
+void usb_msc_bot_device::process_request() {
     switch(_state) {
         case state_t::RECEIVE_CBW: {
-            if (_buffer_out_len == 0) {
+            uint16_t len = _buffer_out_len[_buffer_out_idx];
+            if (len == 0) {
                 // No data received? -> stay in this state and wait...
                 break;
             }
             TUPP_LOG(LOG_DEBUG, "STATE: RECEIVE_CBW");
             // set pointer to CBW
-            auto *cbw = (MSC::cbw_t *) _buffer_out;
+            auto *cbw = (MSC::cbw_t *) _buffer_out[_buffer_out_idx];
 
             // Check the CBW. Is it valid ?
-            if ((_buffer_out_len != sizeof(MSC::cbw_t)) ||
+            if ((len != sizeof(MSC::cbw_t)) ||
                 (cbw->dCBWSignature != MSC::cbw_signature)) {
                 // Error class 6.6.1: Stall bulk endpoints.
                 // Stay in the RECEIVE_CBW state!
                 _ep_in->send_stall(true);
                 _ep_out->send_stall(true);
                 // Signal that data has been processed
-                _buffer_out_len = 0;
+                release_buffer_out();
                 // Let new data flow in
-                _ep_out->send_NAK(false);
+                receive_cbw();
                 return;
             }
 
@@ -181,65 +268,90 @@ void usb_msc_bot_device::handle_request() {
             // Handle the received SCSI command.
             process_scsi_command();
 
-            // Mark data as consumed and accept new packets
-            _buffer_out_len = 0;
-            _ep_out->send_NAK(false);
+            // Mark data as consumed. The next CBW is
+            // received after the CSW has been sent.
+            release_buffer_out();
+            if (_state == state_t::DATA_WRITE) {
+                receive_blocks();
+            }
             break;
         }
         case state_t::SEND_CSW: {
-            if (_ep_in->is_active()) {
-                // EP still active, so keep this state
+            // The CSW is sent directly after the data
+            // stage, so it is queued in the EP.
+            if (!_ep_in->queue_transfer((uint8_t *)&_csw, sizeof(_csw))) {
+                // Queue is full, so keep this state
                 // and wait for the EP to be usable...
                 break;
             }
             TUPP_LOG(LOG_DEBUG, "STATE: SEND_CSW");
-            _ep_in->start_transfer((uint8_t *)&_csw, sizeof(_csw));
             // Continue with next CBW
             _state = state_t::RECEIVE_CBW;
+            receive_cbw();
             break;
         }
         case state_t::DATA_READ: {
-            if (_ep_in->is_active()) {
-                // EP still active, so keep this state
-                // and wait for the EP to be usable...
-                break;
-            }
-            TUPP_LOG(LOG_DEBUG, "STATE: DATA_READ");
-            // Read data from device
-            uint8_t res = read_handler(_buffer_in, _block_addr++);
-            _ep_in->start_transfer(_buffer_in, TUPP_MSC_BLOCK_SIZE);
-            _blocks_transferred++;
-            // Check if all blocks have been received and
-            // we have to leave this state
-            if (_blocks_transferred == _blocks_to_transfer) {
-                _state = state_t::SEND_CSW;
-            }
-            if (res) {
-                scsi_fail(SCSI::sense_key_t::NOT_READY, 0x3a, 0);
+            // Fill all free IN buffers. If both buffers
+            // are in use, keep this state and wait...
+            while ((_state == state_t::DATA_READ) &&
+                   (_ep_in->pending_transfers() < 2)) {
+                TUPP_LOG(LOG_DEBUG, "STATE: DATA_READ");
+                // Read data from device into the free buffer
+                uint8_t * buffer = _buffer_in[_buffer_in_idx];
+                _buffer_in_idx ^= 1;
+                uint8_t res = read_handler(buffer, _block_addr++);
+                _ep_in->queue_transfer(buffer, TUPP_MSC_BLOCK_SIZE);
+                _blocks_transferred++;
+                // Check if all blocks have been received and
+                // we have to leave this state
+                if (_blocks_transferred == _blocks_to_transfer) {
+                    _state = state_t::SEND_CSW;
+                }
+                if (res) {
+                    scsi_fail(SCSI::sense_key_t::NOT_READY, 0x3a, 0);
+                }
             }
             break;
         }
         case state_t::DATA_WRITE: {
-            if (_buffer_out_len == 0) {
-                // No data received? -> keep this state and wait...
-                break;
-            }
-            TUPP_LOG(LOG_DEBUG, "STATE: DATA_WRITE");
-            assert(_buffer_out_len == TUPP_MSC_BLOCK_SIZE);
-            // Write data to device
-            uint8_t res = write_handler(_buffer_out, _block_addr++);
-            _blocks_transferred++;
-            // Check if all blocks have been written and
-            // we have to leave this state
-            if (_blocks_transferred == _blocks_to_transfer) {
-                _state = state_t::SEND_CSW;
-            }
-            if (res) {
-                scsi_fail(SCSI::sense_key_t::NOT_READY, 0x3a, 0);
+            // Write all received buffers to the device. If
+            // no data has been received, keep this state and wait...
+            while ((_state == state_t::DATA_WRITE) &&
+                   _buffer_out_len[_buffer_out_idx]) {
+                TUPP_LOG(LOG_DEBUG, "STATE: DATA_WRITE");
+                // Write all received blocks to the device
+                uint16_t  len    = _buffer_out_len[_buffer_out_idx];
+                uint8_t * buffer = _buffer_out[_buffer_out_idx];
+                uint16_t  blocks = len / TUPP_MSC_BLOCK_SIZE;
+                for (uint16_t i=0; i < blocks; ++i) {
+                    uint8_t res = write_handler(buffer + i * TUPP_MSC_BLOCK_SIZE,
+                                                _block_addr++);
+                    _blocks_transferred++;
+                    if (res) {
+                        scsi_fail(SCSI::sense_key_t::NOT_READY, 0x3a, 0);
+                    }
+                }
+                if (blocks < _blocks_receiving[_buffer_out_idx]) {
+                    // The host has terminated the data stage
+                    // with a short packet. Report the residue.
+                    TUPP_LOG(LOG_WARNING, "WRITE_10: Received less data than expected");
+                    _csw.dCSWDataResidue = (_blocks_to_transfer - _blocks_transferred) *
+                                           TUPP_MSC_BLOCK_SIZE - len % TUPP_MSC_BLOCK_SIZE;
+                    _csw.bCSWStatus      = MSC::csw_status_t::PHASE_ERROR;
+                    _blocks_transferred  = _blocks_to_transfer;
+                }
+                // Mark data as consumed
+                release_buffer_out();
+                // Check if all blocks have been written and we
+                // have to leave this state. Otherwise the next
+                // blocks are already being received, or the
+                // paused reception continues in the free buffer.
+                if (_blocks_transferred == _blocks_to_transfer) {
+                    _state = state_t::SEND_CSW;
+                } else {
+                    resume_blocks();
+                }
             }
-            // Mark data as consumed and accept new packets
-            _buffer_out_len = 0;
-            _ep_out->send_NAK(false);
             break;
         }
     }
@@ -247,7 +359,7 @@ void usb_msc_bot_device::handle_request() {
 
 void usb_msc_bot_device::process_scsi_command() {
     TUPP_LOG(LOG_DEBUG, "process_scsi_command()");
-    auto *  cbw = (MSC::cbw_t *) _buffer_out;
+    auto *  cbw = (MSC::cbw_t *) _buffer_out[_buffer_out_idx];
     auto    cmd = (SCSI::scsi_cmd_t)cbw->CBWCB[0];
 
     uint8_t * response_data;
@@ -413,7 +525,6 @@ void usb_msc_bot_device::process_scsi_command() {
             break;
         }
         case SCSI::scsi_cmd_t::WRITE_10: {
-            _buffer_out_len = 0;
             assert(cbw->bCBWCBLength == sizeof(SCSI::write_10_t));
             auto * write_cmd = (SCSI::write_10_t *)&cbw->CBWCB;
             // Check if we may write to this device
@@ -427,9 +538,6 @@ void usb_msc_bot_device::process_scsi_command() {
                 _sense_fixed_response.sense_key             = SCSI::sense_key_t::DATA_PROTECT;
                 _sense_fixed_response.add_sense_code        = 0x27;
                 _sense_fixed_response.add_sense_qualifier   = 0x00;
-                // Let the next block arrive
-                _buffer_out_len = 0;
-                _ep_out->send_NAK(false);
                 break;
             }
             if (!_device_ready) {
@@ -437,19 +545,17 @@ void usb_msc_bot_device::process_scsi_command() {
                 _sense_fixed_response.sense_key             = SCSI::sense_key_t::NOT_READY;
                 _sense_fixed_response.add_sense_code        = 4;
                 _sense_fixed_response.add_sense_qualifier   = 0;
-                // Let the next block arrive
-                _buffer_out_len = 0;
-                _ep_out->send_NAK(false);
 //                break;
             }
             _blocks_to_transfer = __ntohs(write_cmd->transfer_length);
             _blocks_transferred = 0;
+            _blocks_requested   = 0;
+            _rx_paused          = false;
             _block_addr = __ntohl(write_cmd->logical_block_address);
             TUPP_LOG(LOG_INFO, "SCSI: WRITE_10 (%d blocks)", _blocks_to_transfer);
-            _state = state_t::DATA_WRITE;
-            // Let the next block arrive
-            _buffer_out_len = 0;
-            _ep_out->send_NAK(false);
+            // The blocks are received after the
+            // CBW has been consumed
+            _state = _blocks_to_transfer ? state_t::DATA_WRITE : state_t::SEND_CSW;
             if (!_device_ready) {
                 _csw.bCSWStatus = MSC::csw_status_t::CMD_FAILED;
                 _state = state_t::SEND_CSW;
@@ -484,9 +590,9 @@ void usb_msc_bot_device::process_scsi_command() {
                 if (response_len > response_len_expected) {
                     response_len = response_len_expected;
                 }
-                // Send the response
-                while (_ep_in->is_active());
-                _ep_in->start_transfer(response_data, response_len);
+                // Send the response. It is queued if the
+                // EP is still sending the last CSW.
+                _ep_in->queue_transfer(response_data, response_len);
             } else {
                 TUPP_LOG(LOG_WARNING, "SCSI response expected but no data");
                 _csw.bCSWStatus = MSC::csw_status_t::CMD_FAILED;
@@ -13,6 +13,9 @@
 //
 // This class represents a MSC (Mass Storage Class) BOT (Bulk Only Tramsfer)
 // device. The user interface are 6 handler functions (see below).
+// In dual-core mode (TUPP_DUAL_CORE), the state machine is run by
+// the endpoint handlers, so all handlers are called on the USB core
+// (in the USB interrupt), and handle_request() has nothing to do.
 //
 #ifndef TUPP_USB_MSC_BOT_DEVICE_H
 #define TUPP_USB_MSC_BOT_DEVICE_H
@@ -24,6 +27,7 @@
 #include "usb_endpoint.h"
 #include "usb_device_controller.h"
 #include "usb_config.h"
+#include "usb_delegate.h"
 #include <array>
 
 class usb_msc_bot_device {
@@ -31,28 +35,32 @@ public:
     usb_msc_bot_device(usb_device_controller & controller,
                        usb_configuration     & configuration);
 
-    // Handle next MSC request.
+    // Handle next MSC request. Has to be called regularly,
+    // except in dual-core mode (see above).
     void handle_request();
 
+    // The callback handlers are delegates (see usb_delegate.h), because
+    // in dual-core mode they are called in the USB interrupt.
+
     // Callback handler to get the block size and block count of the device.
     // block size should normally be TUPP_MSC_BLOCK_SIZE, other cases are
     // currently not supported.
-    std::function<void(uint16_t & block_size, uint32_t & block_count)> capacity_handler;
+    delegate<void(uint16_t & block_size, uint32_t & block_count)> capacity_handler;
 
     // Callback handler to read a single block from the device
-    std::function<uint8_t(uint8_t * buff, uint32_t block)> read_handler;
+    delegate<uint8_t(uint8_t * buff, uint32_t block)> read_handler;
 
     // Callback handler to write a single block to the device
-    std::function<uint8_t (uint8_t * buff, uint32_t block)> write_handler;
+    delegate<uint8_t(uint8_t * buff, uint32_t block)> write_handler;
 
     // Callback handler to get the 'writable' state
-    std::function<bool()> is_writeable_handler;
+    delegate<bool()> is_writeable_handler;
 
     // Callback handler to get the start/stop and eject state
-    std::function<void(uint8_t power_condition, bool start, bool load_eject)> start_stop_handler;
+    delegate<void(uint8_t power_condition, bool start, bool load_eject)> start_stop_handler;
 
     // Callback handler for the removable state
-    std::function<void(bool prevent_removal)> remove_handler;
+    delegate<void(bool prevent_removal)> remove_handler;
 
     // Setters for IDs in inquiry response
     void set_vendor_id(const char * id);
@@ -88,12 +96,27 @@ private:
     state_t                     _state;
     MSC::csw_t                  _csw {};
 
-    bool                        _device_ready {true};
-
-    // Internal data buffers
-    volatile uint16_t           _buffer_out_len {0};
-    uint8_t                     _buffer_out[TUPP_MSC_BLOCK_SIZE] {0};
-    uint8_t                     _buffer_in [TUPP_MSC_BLOCK_SIZE] {0};
+    volatile bool               _device_ready {true};
+
+    // Internal data buffers. Two OUT buffers are used alternately.
+    // Each one receives a CBW or up to TUPP_MSC_WRITE_BLOCKS blocks,
+    // so the next blocks of a WRITE_10 can be received while the
+    // previous ones are written. A length of 0 marks a free buffer.
+    static_assert(TUPP_MSC_WRITE_BLOCKS * TUPP_MSC_BLOCK_SIZE <= 0xffff,
+                  "OUT buffer is too large for one transfer");
+    volatile uint16_t           _buffer_out_len[2] {0, 0};
+    uint8_t                     _buffer_out[2][TUPP_MSC_WRITE_BLOCKS * TUPP_MSC_BLOCK_SIZE] {};
+    // Buffer which is processed next by the state machine
+    uint8_t                     _buffer_out_idx {0};
+    // Buffer which receives (or will receive) the next data
+    volatile uint8_t            _buffer_rx_idx {0};
+    // The data stage of a WRITE_10 is paused, because
+    // no OUT buffer was free when a reception ended
+    volatile bool               _rx_paused {false};
+    // Two IN buffers are used alternately, so the next block
+    // can be read while the previous one is being sent.
+    uint8_t                     _buffer_in [2][TUPP_MSC_BLOCK_SIZE] {};
+    uint8_t                     _buffer_in_idx {0};
 
     // Various SCSI response types
     SCSI::inquiry_response_t                    _inquiry_response;
@@ -104,9 +127,25 @@ private:
 
     void process_scsi_command();
 
+    // One step of the state machine
+    void process_request();
+    // Run the state machine until it has to wait for the host
+    void run_request();
+
+    // Start the reception of the next CBW
+    void receive_cbw();
+    // Start the reception of the next blocks of a WRITE_10
+    void receive_blocks();
+    // Continue a paused data stage if a buffer is free again
+    void resume_blocks();
+    // Mark the current OUT buffer as consumed
+    void release_buffer_out();
+
     // Data transfer parameters
     uint16_t                    _blocks_to_transfer {0};
     uint16_t                    _blocks_transferred {0};
+    uint16_t                    _blocks_receiving[2] {0, 0};
+    volatile uint16_t           _blocks_requested {0};
     uint32_t                    _block_addr {0};
 };
 
@@ -0,0 +1,28 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Replacement of the newlib header <machine/endian.h>
+// for Linux hosts. Only the byte order conversions used
+// by tinyUSB++ are provided.
+//
+#ifndef TUPP_SIM_MACHINE_ENDIAN_H
+#define TUPP_SIM_MACHINE_ENDIAN_H
+
+#include <arpa/inet.h>
+
+#define __htonl(x)  htonl(x)
+#define __htons(x)  htons(x)
+#define __ntohl(x)  ntohl(x)
+#define __ntohs(x)  ntohs(x)
+
+#endif // TUPP_SIM_MACHINE_ENDIAN_H
@@ -0,0 +1,40 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+#include "tupp_sim_compat.h"
+
+extern "C" char * itoa(int value, char * str, int base) {
+    // Only base 10 has a sign, all other
+    // bases treat the value as unsigned.
+    unsigned int uval = value;
+    char * ptr = str;
+    if (base == 10 && value < 0) {
+        *ptr++ = '-';
+        uval = -(unsigned int)value;
+    }
+    // Generate the digits in reverse order
+    char * start = ptr;
+    do {
+        unsigned int digit = uval % base;
+        *ptr++ = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        uval /= base;
+    } while (uval);
+    *ptr = '\0';
+    // Reverse the digits
+    for (char * end = ptr - 1; start < end; ++start, --end) {
+        char tmp = *start;
+        *start = *end;
+        *end = tmp;
+    }
+    return str;
+}
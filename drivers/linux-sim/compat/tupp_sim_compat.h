@@ -0,0 +1,34 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Small compatibility layer for building tinyUSB++ on a
+// Linux host with glibc. The embedded toolchains use newlib,
+// which provides some non-standard functions (like itoa).
+// This header is force-included in every compilation unit
+// (see CMakeLists.txt).
+//
+#ifndef TUPP_SIM_COMPAT_H
+#define TUPP_SIM_COMPAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Convert an integer to a string (newlib semantics)
+char * itoa(int value, char * str, int base);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TUPP_SIM_COMPAT_H
@@ -0,0 +1,30 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+#include "usb_dcd.h"
+
+// The simulated hardware
+usb_sim_dpram_t usb_sim_dpram;
+usb_sim_regs_t  usb_sim_hw;
+
+extern "C" {
+void isr_usbctrl(void) {
+    usb_dcd::inst().handle_irq();
+}
+}
+
+void usb_sim_task() {
+#if TUPP_DEFERRED_EVENTS
+    usb_dcd::inst().process_events();
+#endif
+}
@@ -0,0 +1,28 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Implementation of the USB Device Controller Driver (DCD)
+// for a simulated USB device controller on a Linux host.
+// The USB traffic is generated by the virtual host in
+// usb_sim_host.h, which also 'raises' the USB interrupt.
+//
+#ifndef TUPP_USB_DCD_H
+#define TUPP_USB_DCD_H
+
+#include "usb_dcd_hw.h"
+#include "usb_dcd_rp2xxx.h"
+
+using usb_dcd          = usb_dcd_rp2xxx<usb_dcd_hw>;
+using usb_endpoint_sim = usb_endpoint_rp2xxx<usb_dcd_hw>;
+
+#endif // TUPP_USB_DCD_H
@@ -0,0 +1,135 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Register access of the simulated USB device controller,
+// used as template parameter of the common RP2xxx driver
+// (see drivers/rp2xxx/usb_dcd_rp2xxx.h). The simulated SIE
+// is never busy while the CPU is running, so an endpoint is
+// aborted immediately (ABORT_DONE is set with ABORT).
+//
+#ifndef TUPP_USB_DCD_HW_H
+#define TUPP_USB_DCD_HW_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "usb_config.h"
+#include "usb_sim_hw.h"
+
+extern "C" {
+void isr_usbctrl(void);
+};
+
+// The 'USB task' in deferred event mode
+void usb_sim_task();
+
+struct usb_dcd_hw {
+    static inline uint8_t * dpram() {
+        return (uint8_t *)&usb_sim_dpram;
+    }
+
+    static inline void init() {
+        // Clear any previous state in dpram and registers
+        memset(&usb_sim_dpram, 0, sizeof(usb_sim_dpram));
+        memset(&usb_sim_hw,    0, sizeof(usb_sim_hw));
+    }
+
+    static inline void pullup_enable(bool e) {
+        if (e) {
+            usb_sim_hw.sie_ctrl |=  USB_SIE_CTRL_PULLUP_EN_BITS;
+        } else {
+            usb_sim_hw.sie_ctrl &= ~USB_SIE_CTRL_PULLUP_EN_BITS;
+        }
+    }
+
+    static inline void irq_enable(bool e) {
+        _irq_enabled = e;
+        if (e) _irq_core = _core;
+        // Handle interrupts which are already pending
+        raise_irq();
+    }
+
+    // Call the interrupt handler if the IRQ is enabled
+    // and an interrupt is pending (used by the virtual host).
+    // The handler runs on the core which has enabled the IRQ.
+    // Interrupts are not nested: An interrupt raised by the
+    // handler is handled after it has returned. In deferred
+    // event mode, the USB task is scheduled right after the
+    // interrupt.
+    static inline void raise_irq() {
+        if (_in_irq) return;
+        while (_irq_enabled && usb_sim_hw.ints()) {
+            uint8_t core = _core;
+            _core   = _irq_core;
+            _in_irq = true;
+            isr_usbctrl();
+#if TUPP_DEFERRED_EVENTS
+            usb_sim_task();
+#endif
+            _in_irq = false;
+            _core   = core;
+        }
+    }
+
+    static inline uint32_t ints()                     { return usb_sim_hw.ints(); }
+    static inline void     inte_set(uint32_t m)       { usb_sim_hw.inte |=  m; }
+    static inline void     inte_clr(uint32_t m)       { usb_sim_hw.inte &= ~m; }
+    static inline void     sie_status_clr(uint32_t m) { usb_sim_hw.sie_status &= ~m; }
+    static inline uint32_t buf_status()               { return usb_sim_hw.buf_status; }
+    static inline void     buf_status_clr(uint32_t m) { usb_sim_hw.buf_status &= ~m; }
+    static inline uint32_t abort()                    { return usb_sim_hw.abort; }
+    static inline void     abort_set(uint32_t m)      { usb_sim_hw.abort |= m; usb_sim_hw.abort_done |= m; }
+    static inline void     abort_clr(uint32_t m)      { usb_sim_hw.abort &= ~m; }
+    static inline uint32_t abort_done()               { return usb_sim_hw.abort_done; }
+    static inline void     abort_done_clr(uint32_t m) { usb_sim_hw.abort_done &= ~m; }
+    static inline void     stall_arm_set(uint32_t m)  { usb_sim_hw.ep_stall_arm |= m; }
+    static inline void     dev_addr(uint8_t addr)     { usb_sim_hw.dev_addr_ctrl = addr; }
+    static inline uint16_t sof_rd()                   { return usb_sim_hw.read_sof_rd(); }
+    static inline uint8_t  core_num()                 { return _core; }
+    static inline void     intf_clr(uint32_t m)       { usb_sim_hw.intf &= ~m; }
+
+    // The other core handles the forced interrupt immediately
+    static inline void intf_set(uint32_t m) {
+        usb_sim_hw.intf |= m;
+        raise_irq();
+    }
+
+    // The microsecond timer of the simulation
+    static inline uint32_t time_us() {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The time stamp counter of x86 CPUs. Other
+    // hosts count nanoseconds instead of cycles.
+    static constexpr uint32_t CYCLES_MASK = 0xffffffff;
+    static inline uint32_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static inline bool _irq_enabled {false};
+    static inline bool _in_irq {false};
+
+    // The simulated core which is currently running. A program
+    // can set it to simulate a second core (see TUPP_DUAL_CORE).
+    static inline uint8_t _core {0};
+    static inline uint8_t _irq_core {0};
+};
+
+#endif // TUPP_USB_DCD_HW_H
@@ -0,0 +1,446 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+#include "usb_sim_host.h"
+#include "usb_sim_hw.h"
+#include "usb_dcd.h"
+#include "usb_log.h"
+#include <cstring>
+
+using namespace TUPP;
+using enum TUPP::bRequest_t;
+using enum TUPP::bDescriptorType_t;
+using enum TUPP::recipient_t;
+using enum TUPP::type_t;
+using enum TUPP::direction_t;
+using enum usb_log::log_level;
+using enum usb_sim_host::result_t;
+
+usb_sim_host::usb_sim_host(usb_dcd &) {
+    // Default packet size for all endpoints
+    for (auto & ps : _packet_size) {
+        ps[0] = ps[1] = TUPP_DEFAULT_PAKET_SIZE;
+    }
+}
+
+setup_packet_t usb_sim_host::make_setup(direction_t dir,
+                                        type_t      type,
+                                        recipient_t recipient,
+                                        uint8_t     bRequest,
+                                        uint16_t    wValue,
+                                        uint16_t    wIndex,
+                                        uint16_t    wLength) {
+    setup_packet_t pkt {};
+    pkt.recipient = recipient;
+    pkt.type      = type;
+    pkt.direction = dir;
+    pkt.bRequest  = (bRequest_t)bRequest;
+    pkt.wValue    = wValue;
+    pkt.wIndex    = wIndex;
+    pkt.wLength   = wLength;
+    return pkt;
+}
+
+void usb_sim_host::bus_reset() {
+    TUPP_LOG(LOG_DEBUG, "sim host: bus_reset()");
+    // After a reset, the device has address 0
+    // and all data toggles are reset.
+    _address = 0;
+    memset(_pid, 0, sizeof(_pid));
+    memset(_buf_sel, 0, sizeof(_buf_sel));
+    usb_sim_hw.sie_status |= USB_SIE_STATUS_BUS_RESET_BITS;
+    usb_dcd_hw::raise_irq();
+}
+
+usb_sim_host::result_t usb_sim_host::setup(const setup_packet_t & pkt) {
+    _stats.setups++;
+    if (!(usb_sim_hw.sie_ctrl & USB_SIE_CTRL_PULLUP_EN_BITS) ||
+        (usb_sim_hw.dev_addr_ctrl & 0x7f) != _address) {
+        _stats.timeouts++;
+        return TIMEOUT;
+    }
+    // A setup packet is always accepted and clears a
+    // pending EP0 stall. Data and status stages start
+    // with DATA1.
+    memcpy(usb_sim_dpram.setup_packet, &pkt, sizeof(setup_packet_t));
+    usb_sim_hw.ep_stall_arm &= ~0x3u;
+    _pid[0][0] = 1;
+    _pid[0][1] = 1;
+    usb_sim_hw.sie_status |= USB_SIE_STATUS_SETUP_REC_BITS;
+    usb_dcd_hw::raise_irq();
+    return ACK;
+}
+
+bool usb_sim_host::ep_hw(uint8_t ep_addr, ep_hw_t & hw) {
+    uint8_t num = ep_addr & 0x0f;
+    bool    in  = ep_addr & 0x80;
+    hw.buff_ctrl = in ? &usb_sim_dpram.ep_buf_ctrl[num].in
+                      : &usb_sim_dpram.ep_buf_ctrl[num].out;
+    hw.shift     = 0;
+    hw.dbl       = false;
+    if (num == 0) {
+        // EP0 is always enabled and has a fixed buffer
+        hw.buffer = usb_sim_dpram.ep0_buf_a;
+        return true;
+    }
+    uint32_t ep_ctrl = in ? usb_sim_dpram.ep_ctrl[num-1].in
+                          : usb_sim_dpram.ep_ctrl[num-1].out;
+    if (!(ep_ctrl & EP_CTRL_ENABLE_BITS)) {
+        return false;
+    }
+    hw.buffer = (uint8_t *)&usb_sim_dpram + (ep_ctrl & EP_CTRL_BUFFER_ADDRESS_MASK);
+    if (ep_ctrl & EP_CTRL_DOUBLE_BUFFERED_BITS) {
+        // The SIE uses both buffers alternately. The
+        // device might have reset the buffer selector.
+        hw.dbl = true;
+        uint8_t & sel = _buf_sel[num][in];
+        if (*hw.buff_ctrl & USB_BUF_CTRL_SEL) {
+            *hw.buff_ctrl &= ~USB_BUF_CTRL_SEL;
+            sel = 0;
+        }
+        if (sel) {
+            // Buffer 1 follows buffer 0 after 64 bytes, or
+            // after the programmed offset for ISO endpoints.
+            uint32_t type = (ep_ctrl >> EP_CTRL_BUFFER_TYPE_LSB) & 0x3;
+            if (type == (uint32_t)ep_attributes_t::TRANS_ISOCHRONOUS) {
+                hw.buffer += 128 << ((*hw.buff_ctrl >> USB_BUF_CTRL_ISO_OFFSET_LSB) & 0x3);
+            } else {
+                hw.buffer += 64;
+            }
+            hw.shift = 16;
+        }
+    }
+    return true;
+}
+
+usb_sim_host::result_t usb_sim_host::in_token(uint8_t ep_addr, uint8_t * buf, uint16_t & len) {
+    _stats.in_tokens++;
+    uint8_t    num  = ep_addr & 0x0f;
+    uint32_t   mask = 1 << (num << 1);
+    ep_hw_t    hw;
+    if (!(usb_sim_hw.sie_ctrl & USB_SIE_CTRL_PULLUP_EN_BITS) ||
+        (usb_sim_hw.dev_addr_ctrl & 0x7f) != _address ||
+        !ep_hw(ep_addr | 0x80, hw)) {
+        _stats.timeouts++;
+        return TIMEOUT;
+    }
+    // EP0 needs an additional arming of the stall
+    if ((*hw.buff_ctrl & USB_BUF_CTRL_STALL) &&
+        (num || (usb_sim_hw.ep_stall_arm & mask))) {
+        _stats.stalls++;
+        return STALL;
+    }
+    uint32_t bits = *hw.buff_ctrl >> hw.shift;
+    if ((usb_sim_hw.abort & mask) || !(bits & USB_BUF_CTRL_AVAIL)) {
+        _stats.naks++;
+        return NAK;
+    }
+    uint16_t n = bits & USB_BUF_CTRL_LEN_MASK;
+    if (n > len) {
+        _stats.babbles++;
+        return TIMEOUT;
+    }
+    // Transfer the data packet and check the data toggle
+    if (n) memcpy(buf, hw.buffer, n);
+    len = n;
+    uint8_t pid = (bits & USB_BUF_CTRL_DATA1_PID) ? 1 : 0;
+    if (pid != _pid[num][1]) {
+        _stats.toggle_errors++;
+    }
+    _pid[num][1] = pid ^ 1;
+    _stats.bytes_in += n;
+    // Hand the buffer back to the device
+    *hw.buff_ctrl &= ~((USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_FULL) << hw.shift);
+    if (hw.dbl) {
+        _buf_sel[num][1] ^= 1;
+    }
+    usb_sim_hw.buf_status |= mask;
+    usb_dcd_hw::raise_irq();
+    return ACK;
+}
+
+usb_sim_host::result_t usb_sim_host::out_token(uint8_t ep_addr, const uint8_t * buf, uint16_t len) {
+    _stats.out_tokens++;
+    uint8_t    num  = ep_addr & 0x0f;
+    uint32_t   mask = 1 << ((num << 1) + 1);
+    ep_hw_t    hw;
+    if (!(usb_sim_hw.sie_ctrl & USB_SIE_CTRL_PULLUP_EN_BITS) ||
+        (usb_sim_hw.dev_addr_ctrl & 0x7f) != _address ||
+        !ep_hw(ep_addr & 0x0f, hw)) {
+        _stats.timeouts++;
+        return TIMEOUT;
+    }
+    // EP0 needs an additional arming of the stall
+    if ((*hw.buff_ctrl & USB_BUF_CTRL_STALL) &&
+        (num || (usb_sim_hw.ep_stall_arm & mask))) {
+        _stats.stalls++;
+        return STALL;
+    }
+    uint32_t bits = *hw.buff_ctrl >> hw.shift;
+    if ((usb_sim_hw.abort & mask) || !(bits & USB_BUF_CTRL_AVAIL)) {
+        _stats.naks++;
+        return NAK;
+    }
+    if (len > (bits & USB_BUF_CTRL_LEN_MASK)) {
+        _stats.babbles++;
+        return TIMEOUT;
+    }
+    // Transfer the data packet and check the data toggle
+    if (len) memcpy(hw.buffer, buf, len);
+    uint8_t pid = (bits & USB_BUF_CTRL_DATA1_PID) ? 1 : 0;
+    if (pid != _pid[num][0]) {
+        _stats.toggle_errors++;
+    }
+    _pid[num][0] ^= 1;
+    _stats.bytes_out += len;
+    // Hand the buffer back to the device
+    uint32_t reg = *hw.buff_ctrl;
+    reg &= ~((USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_LEN_MASK) << hw.shift);
+    reg |= (USB_BUF_CTRL_FULL | len) << hw.shift;
+    *hw.buff_ctrl = reg;
+    if (hw.dbl) {
+        _buf_sel[num][0] ^= 1;
+    }
+    usb_sim_hw.buf_status |= mask;
+    usb_dcd_hw::raise_irq();
+    return ACK;
+}
+
+void usb_sim_host::sof() {
+    _frame = (_frame + 1) & USB_SOF_RD_BITS;
+    usb_sim_hw.sof_rd = _frame;
+    usb_sim_hw.sof_pending = 1;
+    usb_dcd_hw::raise_irq();
+}
+
+int usb_sim_host::iso_in(uint8_t ep_addr, uint8_t * buf, uint16_t len) {
+    _stats.in_tokens++;
+    uint8_t    num  = ep_addr & 0x0f;
+    uint32_t   mask = 1 << (num << 1);
+    ep_hw_t    hw;
+    if (!(usb_sim_hw.sie_ctrl & USB_SIE_CTRL_PULLUP_EN_BITS) ||
+        (usb_sim_hw.dev_addr_ctrl & 0x7f) != _address ||
+        !ep_hw(ep_addr | 0x80, hw)) {
+        _stats.timeouts++;
+        return -1;
+    }
+    // No handshake: Without an armed buffer,
+    // the device does not send anything.
+    uint32_t bits = *hw.buff_ctrl >> hw.shift;
+    if (!(bits & USB_BUF_CTRL_AVAIL)) {
+        _stats.iso_drops++;
+        return -1;
+    }
+    uint16_t n = bits & USB_BUF_CTRL_LEN_MASK;
+    if (n > len) {
+        _stats.babbles++;
+        return -1;
+    }
+    // Transfer the data packet. ISO packets
+    // are always sent with DATA0.
+    if (n) memcpy(buf, hw.buffer, n);
+    if (bits & USB_BUF_CTRL_DATA1_PID) {
+        _stats.toggle_errors++;
+    }
+    _stats.bytes_in += n;
+    // Hand the buffer back to the device
+    *hw.buff_ctrl &= ~((USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_FULL) << hw.shift);
+    if (hw.dbl) {
+        _buf_sel[num][1] ^= 1;
+    }
+    usb_sim_hw.buf_status |= mask;
+    usb_dcd_hw::raise_irq();
+    return n;
+}
+
+int usb_sim_host::iso_out(uint8_t ep_addr, const uint8_t * buf, uint16_t len) {
+    _stats.out_tokens++;
+    uint8_t    num  = ep_addr & 0x0f;
+    uint32_t   mask = 1 << ((num << 1) + 1);
+    ep_hw_t    hw;
+    if (!(usb_sim_hw.sie_ctrl & USB_SIE_CTRL_PULLUP_EN_BITS) ||
+        (usb_sim_hw.dev_addr_ctrl & 0x7f) != _address ||
+        !ep_hw(ep_addr & 0x0f, hw)) {
+        _stats.timeouts++;
+        return -1;
+    }
+    // No handshake: Without an armed buffer,
+    // the packet is lost.
+    uint32_t bits = *hw.buff_ctrl >> hw.shift;
+    if (!(bits & USB_BUF_CTRL_AVAIL)) {
+        _stats.iso_drops++;
+        return -1;
+    }
+    if (len > (bits & USB_BUF_CTRL_LEN_MASK)) {
+        _stats.babbles++;
+        return -1;
+    }
+    // Transfer the data packet. The device has
+    // to accept it with DATA0.
+    if (len) memcpy(hw.buffer, buf, len);
+    if (bits & USB_BUF_CTRL_DATA1_PID) {
+        _stats.toggle_errors++;
+    }
+    _stats.bytes_out += len;
+    // Hand the buffer back to the device
+    uint32_t reg = *hw.buff_ctrl;
+    reg &= ~((USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_LEN_MASK) << hw.shift);
+    reg |= (USB_BUF_CTRL_FULL | len) << hw.shift;
+    *hw.buff_ctrl = reg;
+    if (hw.dbl) {
+        _buf_sel[num][0] ^= 1;
+    }
+    usb_sim_hw.buf_status |= mask;
+    usb_dcd_hw::raise_irq();
+    return len;
+}
+
+usb_sim_host::result_t usb_sim_host::ep0_in(uint8_t * buf, uint16_t & len) {
+    uint16_t size = len;
+    for (uint16_t i=0; i <= max_naks; ++i) {
+        len = size;
+        result_t res = in_token(0x80, buf, len);
+        if (res != NAK) return res;
+    }
+    return NAK;
+}
+
+usb_sim_host::result_t usb_sim_host::ep0_out(const uint8_t * buf, uint16_t len) {
+    for (uint16_t i=0; i <= max_naks; ++i) {
+        result_t res = out_token(0x00, buf, len);
+        if (res != NAK) return res;
+    }
+    return NAK;
+}
+
+int usb_sim_host::control_in(const setup_packet_t & pkt, uint8_t * buf) {
+    if (setup(pkt) != ACK) return -1;
+    // Data stage
+    uint16_t total = 0;
+    uint16_t mps   = _packet_size[0][1];
+    while (total < pkt.wLength) {
+        uint16_t len = pkt.wLength - total;
+        if (len > mps) len = mps;
+        if (ep0_in(buf + total, len) != ACK) return -1;
+        total += len;
+        if (len < mps) break;
+    }
+    // Status stage
+    _pid[0][0] = 1;
+    if (ep0_out(nullptr, 0) != ACK) return -1;
+    return total;
+}
+
+int usb_sim_host::control_out(const setup_packet_t & pkt, const uint8_t * buf) {
+    if (setup(pkt) != ACK) return -1;
+    // Data stage
+    uint16_t total = 0;
+    uint16_t mps   = _packet_size[0][0];
+    while (total < pkt.wLength) {
+        uint16_t len = pkt.wLength - total;
+        if (len > mps) len = mps;
+        if (ep0_out(buf + total, len) != ACK) return -1;
+        total += len;
+    }
+    // Status stage
+    uint16_t len = 0;
+    _pid[0][1] = 1;
+    if (ep0_in(nullptr, len) != ACK) return -1;
+    // Track the state changes of standard requests
+    if (pkt.type == TYPE_STANDARD) {
+        if (pkt.bRequest == REQ_SET_ADDRESS) {
+            _address = pkt.wValue & 0x7f;
+        }
+        if (pkt.bRequest == REQ_SET_CONFIGURATION) {
+            for (int i=1; i < 16; ++i) {
+                _pid[i][0] = _pid[i][1] = 0;
+            }
+        }
+        if ((pkt.bRequest == REQ_CLEAR_FEATURE) &&
+            (pkt.recipient == REC_ENDPOINT) && (pkt.wValue == 0)) {
+            _pid[pkt.wIndex & 0x0f][pkt.wIndex >> 7] = 0;
+        }
+    }
+    return total;
+}
+
+int usb_sim_host::bulk_in(uint8_t ep_addr, uint8_t * buf, uint16_t len) {
+    uint16_t total = 0;
+    uint16_t mps   = _packet_size[ep_addr & 0x0f][1];
+    while (total < len) {
+        uint16_t n = len - total;
+        result_t res = in_token(ep_addr, buf + total, n);
+        if (res == NAK)   break;
+        if (res != ACK)   return -1;
+        total += n;
+        if (n < mps) break;
+    }
+    return total;
+}
+
+int usb_sim_host::bulk_out(uint8_t ep_addr, const uint8_t * buf, uint16_t len) {
+    uint16_t total = 0;
+    uint16_t mps   = _packet_size[ep_addr & 0x0f][0];
+    while (total < len) {
+        uint16_t n = len - total;
+        if (n > mps) n = mps;
+        result_t res = out_token(ep_addr, buf + total, n);
+        if (res == NAK)   break;
+        if (res != ACK)   return -1;
+        total += n;
+    }
+    return total;
+}
+
+void usb_sim_host::parse_configuration(const uint8_t * desc, uint16_t len) {
+    uint16_t i = 0;
+    while ((i + 1 < len) && desc[i]) {
+        if ((bDescriptorType_t)desc[i+1] == DESC_ENDPOINT) {
+            auto * ep = (const endpoint_descriptor_t *)(desc + i);
+            _packet_size[ep->bEndpointAddress & 0x0f][ep->bEndpointAddress >> 7] =
+                ep->wMaxPacketSize;
+        }
+        i += desc[i];
+    }
+}
+
+bool usb_sim_host::enumerate(uint8_t address, uint8_t configuration) {
+    TUPP_LOG(LOG_INFO, "sim host: enumerate()");
+    bus_reset();
+    // Get the device descriptor
+    device_descriptor_t dev_desc {};
+    auto pkt = make_setup(DIR_IN, TYPE_STANDARD, REC_DEVICE, (uint8_t)REQ_GET_DESCRIPTOR,
+                          (uint16_t)DESC_DEVICE << 8, 0, sizeof(dev_desc));
+    if (control_in(pkt, (uint8_t *)&dev_desc) != sizeof(dev_desc)) return false;
+    _packet_size[0][0] = _packet_size[0][1] = dev_desc.bMaxPacketSize0;
+    // Set the new address
+    pkt = make_setup(DIR_OUT, TYPE_STANDARD, REC_DEVICE, (uint8_t)REQ_SET_ADDRESS,
+                     address, 0, 0);
+    if (control_out(pkt, nullptr) < 0) return false;
+    // Get the configuration descriptor. First only the configuration
+    // descriptor itself, then the complete tree with all interfaces.
+    configuration_descriptor_t conf_desc {};
+    pkt = make_setup(DIR_IN, TYPE_STANDARD, REC_DEVICE, (uint8_t)REQ_GET_DESCRIPTOR,
+                     ((uint16_t)DESC_CONFIGURATION << 8) | (configuration - 1),
+                     0, sizeof(conf_desc));
+    if (control_in(pkt, (uint8_t *)&conf_desc) != sizeof(conf_desc)) return false;
+    uint8_t buf[1024];
+    if (conf_desc.wTotalLength > sizeof(buf)) return false;
+    pkt.wLength = conf_desc.wTotalLength;
+    if (control_in(pkt, buf) != conf_desc.wTotalLength) return false;
+    parse_configuration(buf, conf_desc.wTotalLength);
+    // Finally set the configuration
+    pkt = make_setup(DIR_OUT, TYPE_STANDARD, REC_DEVICE, (uint8_t)REQ_SET_CONFIGURATION,
+                     configuration, 0, 0);
+    return control_out(pkt, nullptr) >= 0;
+}
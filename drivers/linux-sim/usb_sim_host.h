@@ -0,0 +1,163 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// A scripted 'virtual host' for the simulated USB device
+// controller. It plays the role of the USB host and the
+// SIE (serial interface engine) at the same time: It injects
+// bus resets, setup packets and IN/OUT tokens, moves the data
+// to/from the simulated DPRAM and raises the USB interrupt,
+// exactly like the real controller would do.
+// Everything runs synchronously in the calling thread, so a
+// test or benchmark program simply alternates between calls
+// to the virtual host and its own (user-level) device code.
+//
+#ifndef TUPP_USB_SIM_HOST_H
+#define TUPP_USB_SIM_HOST_H
+
+#include <cstdint>
+#include "usb_structs.h"
+#include "usb_dcd.h"
+
+class usb_sim_host {
+public:
+    // Result of a single token sent to the device
+    enum class result_t : uint8_t {
+        ACK     = 0,    // data has been transferred
+        NAK     = 1,    // device is busy, try again later
+        STALL   = 2,    // endpoint is halted
+        TIMEOUT = 3     // no reply (wrong address, disabled EP, ...)
+    };
+
+    // Some statistics of the bus traffic
+    struct statistics_t {
+        uint32_t    setups;
+        uint32_t    in_tokens;
+        uint32_t    out_tokens;
+        uint32_t    naks;
+        uint32_t    stalls;
+        uint32_t    timeouts;
+        uint32_t    toggle_errors;
+        uint32_t    babbles;
+        uint32_t    iso_drops;
+        uint64_t    bytes_in;
+        uint64_t    bytes_out;
+    };
+
+    // Connect the virtual host to the simulated controller
+    explicit usb_sim_host(usb_dcd & dcd);
+
+    // No copy, no assignment
+    usb_sim_host(const usb_sim_host &) = delete;
+    usb_sim_host & operator= (const usb_sim_host &) = delete;
+
+    // Low-level bus events
+    ///////////////////////
+    // For IN tokens, len is the size of the buffer when calling
+    // the method, and the number of received bytes on return.
+    // A packet which does not fit into the buffer (or into the
+    // buffer armed by the device for OUT tokens) is a 'babble'
+    // error and is reported as TIMEOUT.
+    void     bus_reset();
+    result_t setup    (const TUPP::setup_packet_t & pkt);
+    result_t in_token (uint8_t ep_addr, uint8_t * buf, uint16_t & len);
+    result_t out_token(uint8_t ep_addr, const uint8_t * buf, uint16_t len);
+
+    // Control transfers on EP0. Return the number of bytes
+    // transferred in the data stage, or -1 in case of an error
+    // (STALL or no reply from the device).
+    int control_in (const TUPP::setup_packet_t & pkt, uint8_t * buf);
+    int control_out(const TUPP::setup_packet_t & pkt, const uint8_t * buf);
+
+    // Bulk/Interrupt transfers. A transfer is finished when all
+    // bytes have been transferred, a short packet was received or
+    // the device answered with a NAK (nothing else could make
+    // progress in the simulation while the host is waiting).
+    // Return the number of bytes transferred, or -1 on STALL.
+    int bulk_in (uint8_t ep_addr, uint8_t * buf, uint16_t len);
+    int bulk_out(uint8_t ep_addr, const uint8_t * buf, uint16_t len);
+
+    // Isochronous transfers. sof() starts a new frame (and raises
+    // the SOF interrupt, if enabled), and every ISO endpoint
+    // transfers at most one packet per frame (sent with DATA0,
+    // without handshake). Return the number of
+    // bytes transferred, or -1 if the packet was lost, because
+    // the device had no buffer armed (counted as 'iso_drop'),
+    // the packet was too large, or the EP is not enabled.
+    void sof();
+    int  iso_in (uint8_t ep_addr, uint8_t * buf, uint16_t len);
+    int  iso_out(uint8_t ep_addr, const uint8_t * buf, uint16_t len);
+
+    // The current frame number
+    inline uint16_t frame() const { return _frame; }
+
+    // Perform a standard enumeration: Bus reset, get the device
+    // descriptor, set the address, read the complete configuration
+    // descriptor and finally set the configuration.
+    bool enumerate(uint8_t address = 1, uint8_t configuration = 1);
+
+    // Helper to fill in a setup packet
+    static TUPP::setup_packet_t make_setup(TUPP::direction_t dir,
+                                           TUPP::type_t      type,
+                                           TUPP::recipient_t recipient,
+                                           uint8_t           bRequest,
+                                           uint16_t          wValue,
+                                           uint16_t          wIndex,
+                                           uint16_t          wLength);
+
+    // The address currently used by the host
+    inline uint8_t address() const { return _address; }
+
+    // Access and reset the traffic statistics
+    inline const statistics_t & stats() const { return _stats; }
+    inline void reset_stats() { _stats = {}; }
+
+    // Max number of NAKs accepted in a control transfer
+    uint16_t max_naks {100};
+
+private:
+    // The HW resources of an endpoint used by the next token
+    struct ep_hw_t {
+        uint32_t *  buff_ctrl;  // buffer control register
+        uint8_t *   buffer;     // data buffer in DPRAM
+        uint8_t     shift;      // 0 for buffer 0, 16 for buffer 1
+        bool        dbl;        // endpoint is double-buffered
+    };
+
+    // Find the buffer and buffer control bits of an endpoint.
+    // Return false if the endpoint is not enabled.
+    bool ep_hw(uint8_t ep_addr, ep_hw_t & hw);
+
+    // Store the max packet sizes found in a configuration descriptor
+    void parse_configuration(const uint8_t * desc, uint16_t len);
+
+    // Send a token on EP0 and retry on NAK
+    result_t ep0_in (uint8_t * buf, uint16_t & len);
+    result_t ep0_out(const uint8_t * buf, uint16_t len);
+
+    uint8_t         _address {0};
+    uint16_t        _frame {0};
+
+    // Expected data toggle for every endpoint [num][dir]
+    uint8_t         _pid[16][2] {};
+
+    // Max packet size for every endpoint [num][dir]
+    uint16_t        _packet_size[16][2] {};
+
+    // Buffer selector of the SIE for double-buffered
+    // endpoints [num][dir]
+    uint8_t         _buf_sel[16][2] {};
+
+    statistics_t    _stats {};
+};
+
+#endif // TUPP_USB_SIM_HOST_H
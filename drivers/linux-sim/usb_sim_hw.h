@@ -0,0 +1,122 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Register and DPRAM model of the simulated USB device
+// controller. The memory layout and the register bits follow
+// the RP2040 USB controller, so the simulated driver can stay
+// as close as possible to the real hardware drivers. The bit
+// names are the ones used by the pico-sdk.
+//
+#ifndef TUPP_USB_SIM_HW_H
+#define TUPP_USB_SIM_HW_H
+
+#include <cstdint>
+
+// Interrupt status bits
+#define USB_INTS_BUFF_STATUS_BITS           0x00000010u
+#define USB_INTS_BUS_RESET_BITS             0x00001000u
+#define USB_INTS_SETUP_REQ_BITS             0x00010000u
+#define USB_INTS_DEV_SOF_BITS               0x00020000u
+
+// SIE status bits
+#define USB_SIE_STATUS_BUS_RESET_BITS       0x00080000u
+#define USB_SIE_STATUS_SETUP_REC_BITS       0x00020000u
+
+// Frame number of the last SOF
+#define USB_SOF_RD_BITS                     0x000007ffu
+
+// SIE control bits
+#define USB_SIE_CTRL_PULLUP_EN_BITS         0x00010000u
+
+// Endpoint control register bits
+#define EP_CTRL_ENABLE_BITS                 0x80000000u
+#define EP_CTRL_DOUBLE_BUFFERED_BITS        0x40000000u
+#define EP_CTRL_INTERRUPT_PER_BUFFER        0x20000000u
+#define EP_CTRL_INTERRUPT_PER_DOUBLE_BUFFER 0x10000000u
+#define EP_CTRL_BUFFER_TYPE_LSB             26
+#define EP_CTRL_BUFFER_ADDRESS_MASK         0x0000ffffu
+
+// Buffer control register bits (buffer 0). The upper 16 bits
+// contain the same bits for buffer 1 (double-buffered mode).
+#define USB_BUF_CTRL_FULL                   0x00008000u
+#define USB_BUF_CTRL_LAST                   0x00004000u
+#define USB_BUF_CTRL_DATA0_PID              0x00000000u
+#define USB_BUF_CTRL_DATA1_PID              0x00002000u
+#define USB_BUF_CTRL_SEL                    0x00001000u
+#define USB_BUF_CTRL_STALL                  0x00000800u
+#define USB_BUF_CTRL_AVAIL                  0x00000400u
+#define USB_BUF_CTRL_LEN_MASK               0x000003ffu
+// Offset of buffer 1 for isochronous endpoints (128 << value)
+#define USB_BUF_CTRL_ISO_OFFSET_LSB         27
+
+// Size of the simulated DPRAM
+#define USB_SIM_DPRAM_SIZE                  4096
+
+struct usb_sim_dpram_t {
+    // The last received setup packet
+    uint8_t  setup_packet[8];
+    // Endpoint control registers (EP1..EP15)
+    struct {
+        uint32_t in;
+        uint32_t out;
+    } ep_ctrl[15];
+    // Buffer control registers (EP0..EP15)
+    struct {
+        uint32_t in;
+        uint32_t out;
+    } ep_buf_ctrl[16];
+    // Fixed EP0 buffer (shared by IN and OUT)
+    uint8_t  ep0_buf_a[0x40];
+    uint8_t  ep0_buf_b[0x40];
+    // Buffer space for all other endpoints
+    uint8_t  epx_data[USB_SIM_DPRAM_SIZE - 0x180];
+};
+static_assert(sizeof(usb_sim_dpram_t) == USB_SIM_DPRAM_SIZE);
+
+struct usb_sim_regs_t {
+    uint32_t dev_addr_ctrl;
+    uint32_t sie_ctrl;
+    uint32_t sie_status;
+    uint32_t buf_status;
+    uint32_t abort;
+    uint32_t abort_done;
+    uint32_t ep_stall_arm;
+    uint32_t inte;
+    uint32_t intf;
+    uint32_t sof_rd;
+    // Set by a SOF, cleared by reading SOF_RD
+    uint32_t sof_pending;
+
+    inline uint16_t read_sof_rd() {
+        sof_pending = 0;
+        return sof_rd & USB_SOF_RD_BITS;
+    }
+
+    // The interrupt status is derived from the status
+    // registers (plus the forced bits in INTF), and masked
+    // with INTE, just like on the real hardware.
+    inline uint32_t ints() const {
+        uint32_t res = 0;
+        if (sie_status & USB_SIE_STATUS_SETUP_REC_BITS) res |= USB_INTS_SETUP_REQ_BITS;
+        if (sie_status & USB_SIE_STATUS_BUS_RESET_BITS) res |= USB_INTS_BUS_RESET_BITS;
+        if (buf_status) res |= USB_INTS_BUFF_STATUS_BITS;
+        if (sof_pending) res |= USB_INTS_DEV_SOF_BITS;
+        return (res | intf) & inte;
+    }
+};
+
+// The simulated hardware
+extern usb_sim_dpram_t  usb_sim_dpram;
+extern usb_sim_regs_t   usb_sim_hw;
+
+#endif // TUPP_USB_SIM_HW_H
@@ -12,15 +12,11 @@
 // (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
 //
 #include "usb_dcd.h"
-#include "usb_endpoint_rp2040.h"
-#include "usb_log.h"
 #include <cstring>
-#include <cassert>
 
-using namespace _USBCTRL_REGS_;
 using namespace _RESETS_;
 
-usb_dcd::usb_dcd() : _new_addr(0), _should_set_address(false) {
+void usb_dcd_hw::init() {
     // Reset usb controller
     RESETS_SET.RESET.usbctrl <<= 1;
     RESETS_CLR.RESET.usbctrl <<= 1;
@@ -44,104 +40,16 @@ usb_dcd::usb_dcd() : _new_addr(0), _should_set_address(false) {
     USBCTRL_REGS_CLR.SIE_CTRL.EP0_DOUBLE_BUF <<= 1;
     USBCTRL_REGS_SET.SIE_CTRL.EP0_INT_1BUF <<= 1;
 
-    // Enable interrupts ...
-    // ... when a setup packet is received
-    // ... when the bus is reset, and
-    // ... when a buffer is done,
-    USBCTRL_REGS_SET.INTE.SETUP_REQ     <<= 1;
-    USBCTRL_REGS_SET.INTE.BUS_RESET     <<= 1;
-    USBCTRL_REGS_SET.INTE.BUFF_STATUS   <<= 1;
-}
-
-void usb_dcd::pullup_enable(bool e) {
-    USBCTRL_REGS_SET.SIE_CTRL.PULLUP_EN <<= e;
-}
-
-void usb_dcd::irq_enable(bool e) {
-    if (e) {
-        NVIC_ClearPendingIRQ(USBCTRL_IRQ_IRQn);
-        NVIC_EnableIRQ(USBCTRL_IRQ_IRQn);
-    } else {
-        NVIC_DisableIRQ(USBCTRL_IRQ_IRQn);
-    }
-}
-
-void usb_dcd::set_address(uint8_t addr) {
-    _new_addr = addr;
-    TUPP_LOG(LOG_INFO, "Set USB address %d", _new_addr);
-    _should_set_address = true;
-}
-
-void usb_dcd::check_address() {
-    if (_should_set_address) {
-        USBCTRL_REGS.ADDR_ENDP.ADDRESS = _new_addr;
-        _should_set_address = false;
-    }
-}
-
-void usb_dcd::reset_address() {
-    _new_addr = 0;
-    _should_set_address = false;
-    USBCTRL_REGS.ADDR_ENDP.ADDRESS = 0;
-}
-
-usb_endpoint * usb_dcd::create_endpoint(
-        uint8_t addr,
-        ep_attributes_t type,
-        uint16_t packet_size,
-        uint8_t interval,
-        usb_interface * interface) {
-    return new usb_endpoint_rp2040(addr, type, packet_size, interval, interface);
-}
-
-usb_endpoint * usb_dcd::create_endpoint(
-        direction_t     direction,
-        ep_attributes_t type,
-        uint16_t        packet_size,
-        uint8_t         interval,
-        usb_interface * interface) {
-    uint8_t dir = (direction == direction_t::DIR_IN) ? 1 : 0;
-    for (uint8_t i = 0; i < 16; ++i) {
-        if (!_endpoints[i][dir]) {
-            uint8_t addr = i | (dir << 7);
-            return new usb_endpoint_rp2040(addr, type, packet_size, interval, interface);
-        }
-    }
-    assert(!"Could not find a free endpoint!");
-    return nullptr;
+#if TUPP_IRQ_CYCLE_STATS
+    // Let the SysTick run freely with the processor clock
+    SysTick->LOAD = 0x00ffffff;
+    SysTick->VAL  = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
 }
 
 extern "C" {
 void USBCTRL_IRQ_Handler(void) {
-    // Setup packet received
-    if (USBCTRL_REGS.INTS.SETUP_REQ) {
-        USBCTRL_REGS_CLR.SIE_STATUS.SETUP_REC = 1;
-        if (usb_dcd::inst().setup_handler) {
-            usb_dcd::inst().setup_handler((TUPP::setup_packet_t *)&USBCTRL_DPRAM);
-        }
-    }
-    // Bus is reset
-    if (USBCTRL_REGS.INTS.BUS_RESET) {
-        USBCTRL_REGS_CLR.SIE_STATUS.BUS_RESET = 1;
-        if (usb_dcd::inst().bus_reset_handler) {
-            usb_dcd::inst().bus_reset_handler();
-        }
-    }
-    // Buffer status, one or more buffers have completed
-    if (USBCTRL_REGS.INTS.BUFF_STATUS) {
-        uint32_t buffs = USBCTRL_REGS.BUFF_STATUS;
-        uint32_t bit = 1;
-        for(uint32_t i=0; buffs && (i < 32); ++i) {
-            if (buffs & bit) {
-                // Clear bits
-                USBCTRL_REGS_CLR.BUFF_STATUS = bit;
-                buffs ^= bit;
-                // Call internal handler
-                auto ep = usb_dcd::inst()._endpoints[i>>1][!(i&1)];
-                if (ep) ep->_process_buffer();
-            }
-            bit <<= 1;
-        }
-    }
+    usb_dcd::inst().handle_irq();
 }
 }
@@ -12,20 +12,11 @@
 // (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
 //
 #include "usb_dcd.h"
-#include "usb_endpoint_rp2040.h"
-#include "usb_log.h"
 #include <cstring>
-#include <cassert>
 
-#include "hardware/irq.h"
 #include "hardware/resets.h"
-#include "hardware/structs/usb.h"
 
-#define usb_hw_set   ((usb_hw_t *)hw_set_alias_untyped(usb_hw))
-#define usb_hw_clear ((usb_hw_t *)hw_clear_alias_untyped(usb_hw))
-
-usb_dcd::usb_dcd() : _new_addr(0), _should_set_address(false)
-{
+void usb_dcd_hw::init() {
     // Reset usb controller
     reset_block(RESETS_RESET_USBCTRL_BITS);
     unreset_block_wait(RESETS_RESET_USBCTRL_BITS);
@@ -48,101 +39,16 @@ usb_dcd::usb_dcd() : _new_addr(0), _should_set_address(false)
     usb_hw_clear->sie_ctrl = USB_SIE_CTRL_EP0_DOUBLE_BUF_BITS;
     usb_hw_set->sie_ctrl   = USB_SIE_CTRL_EP0_INT_1BUF_BITS;
 
-    // Enable interrupts ...
-    // ... when a setup packet is received
-    // ... when the bus is reset, and
-    // ... when a buffer is done,
-    usb_hw_set->inte = USB_INTE_SETUP_REQ_BITS;
-    usb_hw_set->inte = USB_INTE_BUS_RESET_BITS;
-    usb_hw_set->inte = USB_INTE_BUFF_STATUS_BITS;
-}
-
-void usb_dcd::pullup_enable(bool e) {
-    usb_hw_set->sie_ctrl = USB_SIE_CTRL_PULLUP_EN_BITS;
-}
-
-void usb_dcd::irq_enable(bool e) {
-    irq_set_enabled(USBCTRL_IRQ, e);
-}
-
-void usb_dcd::set_address(uint8_t addr) {
-    _new_addr = addr;
-    TUPP_LOG(LOG_INFO, "Set USB address %d", _new_addr);
-    _should_set_address = true;
-}
-
-void usb_dcd::check_address() {
-    if (_should_set_address) {
-        usb_hw->dev_addr_ctrl = _new_addr;
-        _should_set_address = false;
-    }
-}
-
-void usb_dcd::reset_address() {
-    _new_addr = 0;
-    _should_set_address = false;
-    usb_hw->dev_addr_ctrl = 0;
-}
-
-usb_endpoint * usb_dcd::create_endpoint(
-        uint8_t addr,
-        ep_attributes_t type,
-        uint16_t packet_size,
-        uint8_t interval,
-        usb_interface * interface) {
-    return new usb_endpoint_rp2040(addr, type, packet_size, interval, interface);
-}
-
-usb_endpoint * usb_dcd::create_endpoint(
-        direction_t     direction,
-        ep_attributes_t type,
-        uint16_t        packet_size,
-        uint8_t         interval,
-        usb_interface * interface) {
-    uint8_t dir = (direction == direction_t::DIR_IN) ? 1 : 0;
-    for (uint8_t i = 0; i < 16; ++i) {
-        if (!_endpoints[i][dir]) {
-            uint8_t addr = i | (dir << 7);
-            return new usb_endpoint_rp2040(addr, type, packet_size, interval, interface);
-        }
-    }
-    assert(!"No free endpoints");
-    return nullptr;
+#if TUPP_IRQ_CYCLE_STATS
+    // Let the SysTick run freely with the processor clock
+    systick_hw->rvr = 0x00ffffff;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+#endif
 }
 
-
 extern "C" {
 void isr_usbctrl(void) {
-    uint32_t status = usb_hw->ints;
-    // Setup packet received
-    if (status & USB_INTS_SETUP_REQ_BITS) {
-        usb_hw_clear->sie_status = USB_SIE_STATUS_SETUP_REC_BITS;
-        if (usb_dcd::inst().setup_handler) {
-            usb_dcd::inst().setup_handler((TUPP::setup_packet_t *)USBCTRL_DPRAM_BASE);
-        }
-    }
-    // Bus is reset
-    if (status & USB_INTS_BUS_RESET_BITS) {
-        usb_hw_clear->sie_status = USB_SIE_STATUS_BUS_RESET_BITS;
-        if (usb_dcd::inst().bus_reset_handler) {
-            usb_dcd::inst().bus_reset_handler();
-        }
-    }
-    // Buffer status, one or more buffers have completed
-    if (status & USB_INTS_BUFF_STATUS_BITS) {
-        uint32_t buffs = usb_hw->buf_status;
-        uint32_t bit = 1;
-        for(uint32_t i=0; buffs && (i < 32); ++i) {
-            if (buffs & bit) {
-                // Clear bits
-                usb_hw_clear->buf_status = bit;
-                buffs ^= bit;
-                // Call internal handler
-                auto ep = usb_dcd::inst()._endpoints[i>>1][!(i&1)];
-                if (ep) ep->_process_buffer();
-            }
-            bit <<= 1;
-        }
-    }
+    usb_dcd::inst().handle_irq();
 }
 }
@@ -0,0 +1,84 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Register access of the RP2350 USB device controller using
+// the YAHAL OS, used as template parameter of the common
+// RP2xxx driver (see drivers/rp2xxx/usb_dcd_rp2xxx.h).
+// The hot-path registers are accessed as whole words.
+//
+#ifndef TUPP_USB_DCD_HW_H
+#define TUPP_USB_DCD_HW_H
+
+#include <cstdint>
+
+#include "RP2350.h"
+
+using namespace _USB_;
+using namespace _USB_DPRAM_;
+
+struct usb_dcd_hw {
+    static inline uint8_t * dpram() {
+        return (uint8_t *)&USB_DPRAM;
+    }
+
+    static void init();
+
+    static inline void pullup_enable(bool e) {
+        if (e) {
+            USB_SET.SIE_CTRL.PULLUP_EN <<= 1;
+        } else {
+            USB_CLR.SIE_CTRL.PULLUP_EN <<= 1;
+        }
+    }
+
+    static inline void irq_enable(bool e) {
+        if (e) {
+            NVIC_ClearPendingIRQ(USBCTRL_IRQ_IRQn);
+            NVIC_EnableIRQ(USBCTRL_IRQ_IRQn);
+        } else {
+            NVIC_DisableIRQ(USBCTRL_IRQ_IRQn);
+        }
+    }
+
+    static inline uint32_t ints()                     { return word(USB.INTS); }
+    static inline void     inte_set(uint32_t m)       { word(USB_SET.INTE) = m; }
+    static inline void     inte_clr(uint32_t m)       { word(USB_CLR.INTE) = m; }
+    static inline void     sie_status_clr(uint32_t m) { word(USB_CLR.SIE_STATUS) = m; }
+    static inline uint32_t buf_status()               { return USB.BUFF_STATUS; }
+    static inline void     buf_status_clr(uint32_t m) { USB_CLR.BUFF_STATUS = m; }
+    static inline uint32_t abort()                    { return USB.EP_ABORT; }
+    static inline void     abort_set(uint32_t m)      { USB_SET.EP_ABORT = m; }
+    static inline void     abort_clr(uint32_t m)      { USB_CLR.EP_ABORT = m; }
+    static inline uint32_t abort_done()               { return USB.EP_ABORT_DONE; }
+    static inline void     abort_done_clr(uint32_t m) { USB.EP_ABORT_DONE = m; }
+    static inline void     stall_arm_set(uint32_t m)  { USB_SET.EP_STALL_ARM = m; }
+    static inline void     dev_addr(uint8_t addr)     { USB.ADDR_ENDP.ADDRESS = addr; }
+    static inline uint16_t sof_rd()                   { return USB.SOF_RD.COUNT; }
+    static inline uint32_t time_us()                  { return _TIMER0_::TIMER0.TIMERAWL; }
+    static inline uint8_t  core_num()                 { return _SIO_::SIO.CPUID; }
+    static inline void     intf_set(uint32_t m)       { word(USB_SET.INTF) = m; }
+    static inline void     intf_clr(uint32_t m)       { word(USB_CLR.INTF) = m; }
+
+    // The DWT cycle counter of the Cortex-M33
+    static constexpr uint32_t CYCLES_MASK = 0xffffffff;
+    static inline uint32_t cycles()                   { return DWT->CYCCNT; }
+
+private:
+    // Access a register with bit fields as a whole word
+    template<typename R>
+    static inline volatile uint32_t & word(R & reg) {
+        return *(volatile uint32_t *)&reg;
+    }
+};
+
+#endif // TUPP_USB_DCD_HW_H
@@ -0,0 +1,75 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Register access of the RP2350 USB device controller using
+// the pico-sdk, used as template parameter of the common
+// RP2xxx driver (see drivers/rp2xxx/usb_dcd_rp2xxx.h).
+//
+#ifndef TUPP_USB_DCD_HW_H
+#define TUPP_USB_DCD_HW_H
+
+#include <cstdint>
+
+#include "hardware/irq.h"
+#include "pico/platform.h"
+#include "hardware/timer.h"
+#include "hardware/structs/usb.h"
+#include "hardware/structs/m33.h"
+
+#define usb_hw_set   ((usb_hw_t *)hw_set_alias_untyped(usb_hw))
+#define usb_hw_clear ((usb_hw_t *)hw_clear_alias_untyped(usb_hw))
+
+struct usb_dcd_hw {
+    static inline uint8_t * dpram() {
+        return (uint8_t *)USBCTRL_DPRAM_BASE;
+    }
+
+    static void init();
+
+    static inline void pullup_enable(bool e) {
+        if (e) {
+            usb_hw_set->sie_ctrl   = USB_SIE_CTRL_PULLUP_EN_BITS;
+        } else {
+            usb_hw_clear->sie_ctrl = USB_SIE_CTRL_PULLUP_EN_BITS;
+        }
+    }
+
+    static inline void irq_enable(bool e) {
+        irq_set_enabled(USBCTRL_IRQ, e);
+    }
+
+    static inline uint32_t ints()                     { return usb_hw->ints; }
+    static inline void     inte_set(uint32_t m)       { usb_hw_set->inte = m; }
+    static inline void     inte_clr(uint32_t m)       { usb_hw_clear->inte = m; }
+    static inline void     sie_status_clr(uint32_t m) { usb_hw_clear->sie_status = m; }
+    static inline uint32_t buf_status()               { return usb_hw->buf_status; }
+    static inline void     buf_status_clr(uint32_t m) { usb_hw_clear->buf_status = m; }
+    static inline uint32_t abort()                    { return usb_hw->abort; }
+    static inline void     abort_set(uint32_t m)      { usb_hw_set->abort = m; }
+    static inline void     abort_clr(uint32_t m)      { usb_hw_clear->abort = m; }
+    static inline uint32_t abort_done()               { return usb_hw->abort_done; }
+    static inline void     abort_done_clr(uint32_t m) { usb_hw->abort_done = m; }
+    static inline void     stall_arm_set(uint32_t m)  { usb_hw_set->ep_stall_arm = m; }
+    static inline void     dev_addr(uint8_t addr)     { usb_hw->dev_addr_ctrl = addr; }
+    static inline uint16_t sof_rd()                   { return usb_hw->sof_rd & USB_SOF_RD_BITS; }
+    static inline uint32_t time_us()                  { return time_us_32(); }
+    static inline uint8_t  core_num()                 { return get_core_num(); }
+    static inline void     intf_set(uint32_t m)       { usb_hw_set->intf = m; }
+    static inline void     intf_clr(uint32_t m)       { usb_hw_clear->intf = m; }
+
+    // The DWT cycle counter of the Cortex-M33
+    static constexpr uint32_t CYCLES_MASK = 0xffffffff;
+    static inline uint32_t cycles()                   { return m33_hw->dwt_cyccnt; }
+};
+
+#endif // TUPP_USB_DCD_HW_H
@@ -0,0 +1,451 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Implementation of the USB Device Controller Driver (DCD)
+// for the RP2040 and RP2350 (and the simulated controller).
+// Both chips have the same USB controller, so there is only
+// one implementation, which gets the register access class
+// HW as template parameter. A driver folder only provides
+// its HW class (usb_dcd_hw.h) and the interrupt entry,
+// which calls handle_irq(). The HW class has to provide:
+//
+//   static uint8_t * dpram()                  Base address of the DPRAM
+//   static void      init()                   Reset and setup the controller
+//   static void      pullup_enable(bool e)
+//   static void      irq_enable(bool e)
+//   static uint32_t  ints()                   Interrupt status
+//   static void      inte_set(uint32_t mask)  Enable interrupts
+//   static void      inte_clr(uint32_t mask)  Disable interrupts
+//   static void      sie_status_clr(uint32_t mask)
+//   static uint32_t  buf_status()
+//   static void      buf_status_clr(uint32_t mask)
+//   static uint32_t  abort()
+//   static void      abort_set(uint32_t mask)
+//   static void      abort_clr(uint32_t mask)
+//   static uint32_t  abort_done()
+//   static void      abort_done_clr(uint32_t mask)
+//   static void      stall_arm_set(uint32_t mask)
+//   static void      dev_addr(uint8_t addr)
+//   static uint16_t  sof_rd()                 Frame number (clears SOF IRQ)
+//   static uint32_t  time_us()                Microsecond timer
+//   static uint8_t   core_num()               Number of the calling core
+//   static void      intf_set(uint32_t mask)  Force interrupts
+//   static void      intf_clr(uint32_t mask)
+//
+// and if TUPP_IRQ_CYCLE_STATS is set:
+//
+//   static uint32_t  cycles()                 Up-counting cycle counter
+//   static constexpr uint32_t CYCLES_MASK     Valid bits of cycles()
+//
+#ifndef TUPP_USB_DCD_RP2XXX_H
+#define TUPP_USB_DCD_RP2XXX_H
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+#include "usb_config.h"
+#include "usb_dcd_interface.h"
+#include "usb_endpoint_rp2xxx.h"
+#include "usb_interface.h"
+#include "usb_endpoint_pool.h"
+#include "usb_fifo.h"
+#include "usb_dpram_allocator.h"
+#include "usb_log.h"
+
+template<typename HW>
+class usb_dcd_rp2xxx : public usb_dcd_interface {
+public:
+    using endpoint_t = usb_endpoint_rp2xxx<HW>;
+    friend class usb_endpoint_rp2xxx<HW>;
+
+    static usb_dcd_rp2xxx & inst() {
+        static usb_dcd_rp2xxx _inst;
+        return _inst;
+    }
+
+    void pullup_enable(bool e) override {
+        HW::pullup_enable(e);
+    }
+
+    void irq_enable(bool e) override {
+#if TUPP_DUAL_CORE
+        if (e) _usb_core = HW::core_num();
+#endif
+        HW::irq_enable(e);
+    }
+
+    void set_address(uint8_t addr) override {
+        _new_addr = addr;
+        TUPP_LOG(usb_log::LOG_INFO, "Set USB address %d", _new_addr);
+        _should_set_address = true;
+    }
+
+    void reset_address() override {
+        _new_addr = 0;
+        _should_set_address = false;
+        HW::dev_addr(0);
+    }
+
+    uint16_t frame_number() override {
+        // Reading SOF_RD clears the SOF interrupt, so the
+        // value of the last SOF IRQ is used if it is enabled.
+        return _sof_enabled ? _frame : HW::sof_rd();
+    }
+
+    void sof_enable(bool e) override {
+        _frame       = HW::sof_rd();
+        _sof_time    = HW::time_us();
+        _sof_enabled = e;
+        if (e) {
+            HW::inte_set(INTS_DEV_SOF);
+        } else {
+            HW::inte_clr(INTS_DEV_SOF);
+        }
+    }
+
+    uint32_t us_since_sof() override {
+        return HW::time_us() - _sof_time;
+    }
+
+    // Create a new endpoint based on its address.
+    usb_endpoint * create_endpoint(
+                         uint8_t         addr,
+                         ep_attributes_t type,
+                         uint16_t        packet_size,
+                         uint8_t         interval,
+                         usb_interface * interface) override {
+        if (_endpoints[ep_index(addr)]) {
+            assert(!"Endpoint address already in use");
+            return nullptr;
+        }
+        void * mem = _ep_pool.allocate();
+        if (!mem) return nullptr;
+        return new (mem) endpoint_t(addr, type, packet_size, interval, interface);
+    }
+
+    // Create a new endpoint based on its direction.
+    // The next free available address is used.
+    usb_endpoint * create_endpoint(
+                         direction_t     direction,
+                         ep_attributes_t type,
+                         uint16_t        packet_size,
+                         uint8_t         interval,
+                         usb_interface * interface) override {
+        uint8_t dir = (direction == direction_t::DIR_IN) ? 1 : 0;
+        for (uint8_t i = 0; i < 16; ++i) {
+            if (!_endpoints[ep_index(i | (dir << 7))]) {
+                uint8_t addr = i | (dir << 7);
+                void * mem = _ep_pool.allocate();
+                if (!mem) return nullptr;
+                return new (mem) endpoint_t(addr, type, packet_size, interval, interface);
+            }
+        }
+        assert(!"No free endpoints");
+        return nullptr;
+    }
+
+    inline void check_address() {
+        if (_should_set_address) {
+            HW::dev_addr(_new_addr);
+            _should_set_address = false;
+        }
+    }
+
+    bool call_on_usb_core(delegate<void()> func) override {
+#if TUPP_DUAL_CORE
+        // Queue the call and force the USB interrupt,
+        // which is handled by the other core
+        if (HW::core_num() != _usb_core) {
+            if (!_calls.put(func)) return false;
+            HW::intf_set(INTS_CALLS);
+            return true;
+        }
+#endif
+        func();
+        return true;
+    }
+
+    inline usb_endpoint * addr_to_ep(uint8_t addr) override {
+        return _endpoints[ep_index(addr)];
+    }
+
+    // Index of an endpoint in _endpoints. This is also its
+    // bit in the BUFF_STATUS register (IN on the even bits).
+    static constexpr uint8_t ep_index(uint8_t addr) {
+        return ((addr & 0x0f) << 1) | !(addr >> 7);
+    }
+
+    // The static storage of all endpoints
+    inline const usb_endpoint_pool<endpoint_t> & endpoint_pool() const {
+        return _ep_pool;
+    }
+
+    // The allocator of the endpoint buffers in DPRAM
+    using dpram_allocator_t = usb_dpram_allocator<4096 - 0x180>;
+    inline const dpram_allocator_t & dpram() const {
+        return _dpram;
+    }
+
+#if TUPP_IRQ_CYCLE_STATS
+    // Cycles spent in the interrupt handler, and the latency
+    // from the interrupt entry to the call of the handlers
+    struct irq_stats_t {
+        uint32_t count;         // Number of interrupts
+        uint32_t last;          // Cycles of the last interrupt
+        uint32_t max;           // Maximum cycles of an interrupt
+        uint64_t total;         // Sum of all cycles
+        uint32_t events;        // Number of dispatched events
+        uint32_t latency_max;   // Maximum latency of an event
+        uint64_t latency_total; // Sum of all latencies
+    };
+    inline const irq_stats_t & irq_stats() const {
+        return _irq_stats;
+    }
+    inline void reset_irq_stats() {
+        _irq_stats = {};
+    }
+#endif
+
+    // The USB interrupt handler. Has to be called
+    // from the interrupt entry of the platform.
+    inline void handle_irq() {
+        uint32_t start = 0;
+#if TUPP_IRQ_CYCLE_STATS
+        start = HW::cycles();
+#endif
+#if TUPP_DEFERRED_EVENTS
+        // One interrupt records up to 5 events. If they might
+        // not fit into the queue, the interrupts are left pending
+        // and the IRQ is disabled until process_events() has
+        // made room again.
+        if (_events.available_put() < 5) {
+            HW::irq_enable(false);
+            _events_overflow = true;
+            notify_events();
+            return;
+        }
+#endif
+        uint32_t status = HW::ints();
+        // Start of frame. Handled first, so that ISO endpoints
+        // see the new frame number. Reading SOF_RD clears the IRQ.
+        if (status & INTS_DEV_SOF) {
+            _sof_time = HW::time_us();
+            _frame    = HW::sof_rd();
+            event(EVENT_SOF, _frame, start);
+        }
+        // Setup packet received
+        if (status & INTS_SETUP_REQ) {
+            HW::sie_status_clr(SIE_STATUS_SETUP_REC);
+            event(EVENT_SETUP, 0, start);
+        }
+        // Bus is reset
+        if (status & INTS_BUS_RESET) {
+            HW::sie_status_clr(SIE_STATUS_BUS_RESET);
+            event(EVENT_BUS_RESET, 0, start);
+        }
+        // Buffer status, one or more buffers have completed.
+        // Clear all bits with one write. A buffer completing
+        // while the others are processed raises a new IRQ.
+        if (status & INTS_BUFF_STATUS) {
+            uint32_t buffs = HW::buf_status();
+            HW::buf_status_clr(buffs);
+            event(EVENT_BUFFERS, buffs, start);
+        }
+#if TUPP_DUAL_CORE
+        // Calls queued by the other core. The force bit is
+        // cleared first, so a new call raises a new IRQ.
+        if (status & INTS_CALLS) {
+            HW::intf_clr(INTS_CALLS);
+            event(EVENT_CALLS, 0, start);
+        }
+#endif
+#if TUPP_DEFERRED_EVENTS
+        notify_events();
+#endif
+#if TUPP_IRQ_CYCLE_STATS
+        uint32_t cycles = (HW::cycles() - start) & HW::CYCLES_MASK;
+        _irq_stats.count++;
+        _irq_stats.last   = cycles;
+        _irq_stats.total += cycles;
+        if (cycles > _irq_stats.max) _irq_stats.max = cycles;
+#endif
+    }
+
+#if TUPP_DEFERRED_EVENTS
+    // In deferred mode, the interrupt handler only records the
+    // USB events, and this method calls the handlers (setup,
+    // bus reset, SOF and all endpoint handlers). It has to be
+    // called regularly by a task or the main loop, but never
+    // concurrently. Return the number of processed events.
+    // The task does not need to poll: events_pending_handler
+    // is called at the end of every interrupt which has recorded
+    // events (or has found the queue full), e.g. to give a
+    // semaphore or send a task notification from the ISR.
+    int process_events() {
+        event_t e;
+        int n = 0;
+        while (_events.get(e)) {
+            dispatch(e.type, e.data, &e.setup, e.stamp);
+            ++n;
+        }
+        if (_events_overflow) {
+            _events_overflow = false;
+            HW::irq_enable(true);
+        }
+        return n;
+    }
+
+    // Handler called in the IRQ context when events are
+    // waiting for process_events()
+    delegate<void()> events_pending_handler;
+#endif
+
+private:
+    // Interrupt status/enable bits
+    static constexpr uint32_t INTS_BUFF_STATUS     = 1u << 4;
+    static constexpr uint32_t INTS_BUS_RESET       = 1u << 12;
+    static constexpr uint32_t INTS_SETUP_REQ       = 1u << 16;
+    static constexpr uint32_t INTS_DEV_SOF         = 1u << 17;
+    // Only used in host mode, so it is forced (INTF) to
+    // run the calls queued by call_on_usb_core()
+    static constexpr uint32_t INTS_CALLS           = 1u << 0;
+
+    // SIE status bits
+    static constexpr uint32_t SIE_STATUS_SETUP_REC = 1u << 17;
+    static constexpr uint32_t SIE_STATUS_BUS_RESET = 1u << 19;
+
+    // USB events found by the interrupt handler
+    enum event_type_t : uint8_t {
+        EVENT_SOF, EVENT_SETUP, EVENT_BUS_RESET, EVENT_BUFFERS, EVENT_CALLS
+    };
+
+    // Call the handlers of an event. data is the frame number
+    // (SOF) or the BUFF_STATUS bits, stamp the cycle counter
+    // at the interrupt entry.
+    inline void dispatch(event_type_t type, uint32_t data,
+                         TUPP::setup_packet_t * setup, uint32_t stamp) {
+#if TUPP_IRQ_CYCLE_STATS
+        uint32_t latency = (HW::cycles() - stamp) & HW::CYCLES_MASK;
+        _irq_stats.events++;
+        _irq_stats.latency_total += latency;
+        if (latency > _irq_stats.latency_max) _irq_stats.latency_max = latency;
+#else
+        (void)stamp;
+#endif
+        switch(type) {
+            case EVENT_SOF:
+                if (sof_handler) sof_handler(data);
+                break;
+            case EVENT_SETUP:
+                if (setup_handler) setup_handler(setup);
+                break;
+            case EVENT_BUS_RESET:
+                if (bus_reset_handler) bus_reset_handler();
+                break;
+            case EVENT_BUFFERS:
+                // Only visit the set bits, lowest first
+                while (data) {
+                    endpoint_t * ep = _endpoints[std::countr_zero(data)];
+                    data &= data - 1;
+                    if (ep) ep->_process_buffer();
+                }
+                break;
+            case EVENT_CALLS: {
+#if TUPP_DUAL_CORE
+                delegate<void()> func;
+                while (_calls.get(func)) func();
+#endif
+                break;
+            }
+        }
+    }
+
+#if TUPP_DEFERRED_EVENTS
+    // A recorded event. The setup packet is copied,
+    // because the next one might overwrite it in DPRAM.
+    struct event_t {
+        event_type_t         type;
+        uint32_t             data;
+        uint32_t             stamp;
+        TUPP::setup_packet_t setup;
+    };
+
+    inline void event(event_type_t type, uint32_t data, uint32_t stamp) {
+        event_t e { type, data, stamp, {} };
+        if (type == EVENT_SETUP) {
+            e.setup = *(TUPP::setup_packet_t *)HW::dpram();
+        }
+        _events.put(e);
+    }
+
+    // Wake up the task which calls process_events()
+    inline void notify_events() {
+        if (events_pending_handler && _events.available_get()) {
+            events_pending_handler();
+        }
+    }
+#else
+    inline void event(event_type_t type, uint32_t data, uint32_t stamp) {
+        dispatch(type, data, (TUPP::setup_packet_t *)HW::dpram(), stamp);
+    }
+#endif
+
+    usb_dcd_rp2xxx() : _dpram(HW::dpram() + 0x180) {
+        HW::init();
+        // Enable interrupts ...
+        // ... when a setup packet is received
+        // ... when the bus is reset, and
+        // ... when a buffer is done,
+        HW::inte_set(INTS_SETUP_REQ | INTS_BUS_RESET | INTS_BUFF_STATUS);
+#if TUPP_DUAL_CORE
+        // ... and when the other core has queued calls. INTS
+        // is masked by INTE, also for the forced bits in INTF.
+        HW::inte_set(INTS_CALLS);
+#endif
+    }
+
+    // All endpoints, indexed by their BUFF_STATUS bit
+    endpoint_t *        _endpoints[32] {};
+    usb_endpoint_pool<endpoint_t> _ep_pool;
+    dpram_allocator_t   _dpram;
+
+    uint8_t             _new_addr {0};
+    bool                _should_set_address {false};
+
+    // Frame number and time stamp of the last SOF
+    volatile uint16_t   _frame {0};
+    volatile uint32_t   _sof_time {0};
+    bool                _sof_enabled {false};
+
+#if TUPP_IRQ_CYCLE_STATS
+    irq_stats_t         _irq_stats {};
+#endif
+
+#if TUPP_DUAL_CORE
+    // Calls from the other core, and the core
+    // which handles the USB interrupt
+    fifo<delegate<void()>, TUPP_CALL_QUEUE_SIZE> _calls;
+    uint8_t             _usb_core {0};
+#endif
+
+#if TUPP_DEFERRED_EVENTS
+    // The events recorded by the interrupt handler
+    static_assert(TUPP_EVENT_QUEUE_SIZE >= 6, "Event queue is too small for one interrupt");
+    fifo<event_t, TUPP_EVENT_QUEUE_SIZE> _events;
+    volatile bool       _events_overflow {false};
+#endif
+};
+
+#endif // TUPP_USB_DCD_RP2XXX_H
@@ -0,0 +1,307 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Implementation of the USB endpoint class for the USB
+// device controller of the RP2040 and RP2350 (and the
+// simulated controller, which has the same layout).
+// The register access is done by the HW class (see
+// usb_dcd_hw.h in the driver folders), which only has
+// static inline methods. So all register accesses are
+// inlined, and the class is final, so that the calls
+// from the interrupt handler are not virtual.
+//
+#ifndef TUPP_USB_ENDPOINT_RP2XXX_H
+#define TUPP_USB_ENDPOINT_RP2XXX_H
+
+#include <cassert>
+#include <cstdint>
+
+#include "usb_endpoint.h"
+#include "usb_log.h"
+
+class usb_interface;
+
+template<typename HW>
+class usb_dcd_rp2xxx;
+
+template<typename HW>
+class usb_endpoint_rp2xxx final : public usb_endpoint {
+public:
+    friend class usb_dcd_rp2xxx<HW>;
+
+    void enable_endpoint(bool b) override {
+        TUPP_LOG(usb_log::LOG_INFO, "Endpoint 0x%x enabled: %b", descriptor.bEndpointAddress, b);
+        if (_endp_ctrl) {
+            if (b) {
+                *_endp_ctrl = *_endp_ctrl |  EP_CTRL_ENABLE;
+            } else {
+                *_endp_ctrl = *_endp_ctrl & ~EP_CTRL_ENABLE;
+            }
+        }
+    }
+
+    void send_stall(bool b) override {
+        if (b) {
+            if ((descriptor.bEndpointAddress & 0xf) == 0) {
+                HW::stall_arm_set(_mask);
+            }
+            *_buff_ctrl = *_buff_ctrl | BUF_CTRL_STALL;
+            _next_pid = 0;
+        } else {
+            _next_pid = 0;
+            *_buff_ctrl = *_buff_ctrl & ~(BUF_CTRL_STALL | BUF_CTRL_AVAIL | (BUF_CTRL_AVAIL << 16));
+        }
+    }
+
+    bool is_stalled() const override {
+        return *_buff_ctrl & BUF_CTRL_STALL;
+    }
+
+    void send_NAK(bool b) override {
+        if (b) {
+            HW::abort_set(_mask);
+        } else {
+            HW::abort_clr(_mask);
+        }
+    }
+
+    bool set_double_buffered(bool b) override {
+        if (b == _double_buffered) return true;
+        // Only supported for bulk and ISO endpoints
+        if (!_endp_ctrl || _active ||
+            ((descriptor.bmAttributes != ep_attributes_t::TRANS_BULK) &&
+             (descriptor.bmAttributes != ep_attributes_t::TRANS_ISOCHRONOUS))) {
+            return false;
+        }
+        return alloc_buffers(_hw_buffer_size, b);
+    }
+
+    bool set_packet_size(uint16_t packet_size) override {
+        if (!_endp_ctrl || _active) return false;
+        // Same alignment as in the CTOR
+        assert(packet_size <= (is_iso() ? 1023 : 64));
+        uint16_t size = (packet_size + 63) & 0xffc0;
+        if (!alloc_buffers(size, _double_buffered)) return false;
+        set_wMaxPacketSize(is_iso() ? packet_size : size);
+        return true;
+    }
+
+private:
+    // Bits in the endpoint control register
+    static constexpr uint32_t EP_CTRL_ENABLE      = 1u << 31;
+    static constexpr uint32_t EP_CTRL_DOUBLE_BUF  = 1u << 30;
+    static constexpr uint32_t EP_CTRL_IRQ_PER_BUF = 1u << 29;
+    static constexpr uint32_t EP_CTRL_TYPE_LSB    = 26;
+    static constexpr uint32_t EP_CTRL_ADDR_MASK   = 0xffff;
+
+    // Bits in one half-word of the buffer control register
+    // (the upper half-word is used for buffer 1)
+    static constexpr uint16_t BUF_CTRL_FULL       = 1 << 15;
+    static constexpr uint16_t BUF_CTRL_PID        = 1 << 13;
+    static constexpr uint16_t BUF_CTRL_SEL        = 1 << 12;
+    static constexpr uint16_t BUF_CTRL_STALL      = 1 << 11;
+    static constexpr uint16_t BUF_CTRL_AVAIL      = 1 << 10;
+    static constexpr uint16_t BUF_CTRL_LEN_MASK   = 0x3ff;
+    static constexpr uint16_t BUF_CTRL_ISO_LSB    = 11;
+
+    usb_endpoint_rp2xxx(uint8_t  addr,
+                        ep_attributes_t transfer_type,
+                        uint16_t packet_size = 64,
+                        uint8_t  interval    = 0,
+                        usb_interface * interface = nullptr)
+        : usb_endpoint(addr, transfer_type, packet_size, interval, interface)
+    {
+        // Align packet size to multiples of 64 byte. ISO
+        // endpoints keep their packet size (up to 1023 bytes),
+        // only their buffer size is aligned.
+        if (is_iso()) {
+            assert(packet_size <= 1023);
+        }
+        if (packet_size & 0x3f) packet_size += 64;
+        packet_size &= 0xffc0;
+        if (!is_iso()) {
+            set_wMaxPacketSize(packet_size);
+        }
+
+        // Set Hardware registers. The endpoint control
+        // registers start at offset 0x00 (EP0 has none),
+        // the buffer control registers at offset 0x80.
+        uint8_t offset = (addr & 0x0f) << 1;
+
+        if (offset) {
+            _endp_ctrl = (volatile uint32_t *)HW::dpram() + offset;
+            if (!is_IN()) _endp_ctrl++;
+            // Allocate the buffer in DPRAM
+            bool ok = alloc_buffers(packet_size, false);
+            assert(ok);
+            (void)ok;
+        } else {
+            // Handle special case EP0
+            _endp_ctrl = nullptr;
+            _hw_buffer = HW::dpram() + 0x100;
+            _hw_buffer_size = packet_size;
+            assert(_hw_buffer_size == 64);
+        }
+        _buff_ctrl = (volatile uint32_t *)(HW::dpram() + 0x80) + offset;
+        if (!is_IN()) _buff_ctrl++;
+
+        // Set endpoint control register
+        if (_endp_ctrl) {
+            uint32_t reg = (_hw_buffer - HW::dpram()) & EP_CTRL_ADDR_MASK;
+            reg |= EP_CTRL_IRQ_PER_BUF;
+            reg |= (uint32_t)descriptor.bmAttributes << EP_CTRL_TYPE_LSB;
+            reg |= EP_CTRL_ENABLE;
+            *_endp_ctrl = reg;
+        }
+
+        // Initial PID value
+        _next_pid = 0;
+
+        // Initialize bitmask (used for some registers)
+        _mask = 1 << offset;
+        if (!is_IN()) _mask <<= 1;
+
+        // Store this endpoint in lookup table
+        usb_dcd_rp2xxx<HW>::inst()._endpoints[usb_dcd_rp2xxx<HW>::ep_index(addr)] = this;
+    }
+
+    inline void _process_buffer() {
+        // ISO packets are counted per frame
+        if (is_iso()) {
+            iso_frame(usb_dcd_rp2xxx<HW>::inst().frame_number());
+        }
+        if (_double_buffered) {
+            // Both buffers might have been completed, and a
+            // buffer might have been handled already in an
+            // earlier call. So check the AVAIL bits, which
+            // are cleared by the SIE.
+            while (_pending) {
+                uint32_t bits = *_buff_ctrl >> (_done_buf ? 16 : 0);
+                if (bits & BUF_CTRL_AVAIL) break;
+                if (is_IN()) {
+                    handle_buffer_in(bits & BUF_CTRL_LEN_MASK);
+                } else {
+                    handle_buffer_out(bits & BUF_CTRL_LEN_MASK);
+                }
+            }
+            return;
+        }
+        // Dispatch request according endpoint direction
+        if (is_IN()) {
+            usb_dcd_rp2xxx<HW>::inst().check_address();
+            handle_buffer_in(*_buff_ctrl & BUF_CTRL_LEN_MASK);
+        } else {
+            handle_buffer_out(*_buff_ctrl & BUF_CTRL_LEN_MASK);
+        }
+    }
+
+    // (Re-)allocate the HW buffer(s) in DPRAM
+    bool alloc_buffers(uint16_t size, bool double_buffered) {
+        auto & dpram = usb_dcd_rp2xxx<HW>::inst()._dpram;
+        // Buffer 1 is located 64 bytes after buffer 0. ISO
+        // endpoints use an offset of 128, 256, 512 or 1024.
+        uint16_t offset     = 64;
+        uint32_t iso_offset = 0;
+        if (double_buffered && is_iso()) {
+            offset = 128;
+            while (offset < size) {
+                offset <<= 1;
+                iso_offset++;
+            }
+        }
+        uint16_t total = (double_buffered && size) ? offset + size : size;
+        // Release our buffers first, so their space can be
+        // used for the new layout.
+        dpram.release(_hw_buffer, _dpram_size);
+        uint8_t * buf = dpram.allocate(total);
+        bool ok = buf || !total;
+        if (ok) {
+            _hw_buffer       = buf;
+            _hw_buffer_1     = (buf && double_buffered) ? buf + offset : nullptr;
+            _hw_buffer_size  = size;
+            _dpram_size      = total;
+            _iso_offset      = iso_offset;
+            _double_buffered = double_buffered;
+        } else {
+            TUPP_LOG(usb_log::LOG_WARNING, "No DPRAM for %d bytes (endpoint 0x%x)",
+                     total, descriptor.bEndpointAddress);
+            // Allocate the old buffers again (this always
+            // succeeds, but maybe at another address)
+            uint16_t old_offset = _hw_buffer_1 - _hw_buffer;
+            _hw_buffer   = dpram.allocate(_dpram_size);
+            _hw_buffer_1 = _hw_buffer_1 ? _hw_buffer + old_offset : nullptr;
+        }
+        // Update endpoint control register
+        uint32_t reg = *_endp_ctrl & ~(EP_CTRL_ADDR_MASK | EP_CTRL_DOUBLE_BUF);
+        if (_hw_buffer) {
+            reg |= (_hw_buffer - HW::dpram()) & EP_CTRL_ADDR_MASK;
+        }
+        if (_double_buffered) {
+            reg |= EP_CTRL_DOUBLE_BUF;
+        }
+        *_endp_ctrl = reg;
+        return ok;
+    }
+
+    void trigger_transfer(uint16_t len, uint8_t buf) override {
+        // Prepare buffer control value
+        uint16_t reg = len | BUF_CTRL_AVAIL;
+        reg |= _next_pid ? BUF_CTRL_PID  : 0;
+        reg |= is_IN()   ? BUF_CTRL_FULL : 0;
+        // Flip PID
+        _next_pid ^= 1;
+        if (_double_buffered) {
+            // Only write the half-word of our buffer, because the
+            // SIE might be working on the other buffer. If this is
+            // the only armed buffer, reset the buffer selector.
+            volatile uint16_t * half = (volatile uint16_t *)_buff_ctrl + buf;
+            assert((*half & BUF_CTRL_AVAIL) == 0);
+            if (buf) {
+                reg |= _iso_offset << BUF_CTRL_ISO_LSB;
+            } else if (_pending == 1) {
+                reg |= BUF_CTRL_SEL;
+            }
+            *half = reg;
+            return;
+        }
+        assert((*_buff_ctrl & BUF_CTRL_AVAIL) == 0);
+        // Write value to register
+        *_buff_ctrl = reg;
+    }
+
+    void cancel_buffer() override {
+        // The buffer may only be modified while the endpoint
+        // is aborted (the host will see NAKs meanwhile).
+        bool nak = HW::abort() & _mask;
+        HW::abort_set(_mask);
+        while (!(HW::abort_done() & _mask)) ;
+        volatile uint16_t * half = (volatile uint16_t *)_buff_ctrl + _done_buf;
+        *half = *half & ~BUF_CTRL_AVAIL;
+        HW::abort_done_clr(_mask);
+        if (!nak) HW::abort_clr(_mask);
+    }
+
+    volatile uint32_t *   _endp_ctrl;
+    volatile uint32_t *   _buff_ctrl;
+
+    uint16_t              _hw_buffer_size;
+    // Size of the allocated DPRAM block (both buffers)
+    uint16_t              _dpram_size {0};
+
+    uint32_t              _mask;
+
+    // Buffer 1 offset bits for ISO endpoints
+    uint32_t              _iso_offset {0};
+};
+
+#endif  // TUPP_USB_ENDPOINT_RP2XXX_H
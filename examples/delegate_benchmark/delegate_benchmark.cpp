@@ -0,0 +1,116 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Benchmark of the callback mechanisms on a Linux host.
+// A handler with the signature of usb_endpoint::data_handler
+// is called through a plain function pointer, a delegate
+// (with a lambda and with a bound member function) and a
+// std::function. The compiler can not see which callable is
+// stored, so every call is a real indirect call. The program
+// also counts the heap allocations when a handler is assigned.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+#include "usb_delegate.h"
+
+using clk = std::chrono::steady_clock;
+
+// Count all heap allocations
+static uint32_t allocations = 0;
+
+void * operator new(size_t n) {
+    ++allocations;
+    if (void * p = malloc(n)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+
+struct receiver {
+    uint32_t sum {0};
+    void data_handler(uint8_t * buf, uint16_t len) {
+        sum += buf[0] + len;
+    }
+};
+
+static uint32_t plain_sum = 0;
+static void plain_handler(uint8_t * buf, uint16_t len) {
+    plain_sum += buf[0] + len;
+}
+
+// Hide the callable from the optimizer
+template<typename T>
+static T * opaque(T * p) {
+    asm volatile("" : "+r"(p) : : "memory");
+    return p;
+}
+
+template<typename F>
+__attribute__((noinline))
+static double measure(const char * name, F & handler, uint32_t count) {
+    uint8_t buf[64] {1};
+    F * h = opaque(&handler);
+    auto start = clk::now();
+    for (uint32_t i=0; i < count; ++i) {
+        (*h)(buf, (uint16_t)i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(clk::now() - start).count() / count;
+    printf("%-22s: %6.2f ns/call\n", name, ns);
+    return ns;
+}
+
+int main() {
+    const uint32_t count = 200000000;
+    receiver rec;
+    uint32_t lambda_sum = 0;
+
+    // Plain function pointer as a reference
+    void (*fptr)(uint8_t *, uint16_t) = plain_handler;
+    measure("function pointer", fptr, count);
+
+    // Delegate with a lambda (like in the USB classes)
+    delegate<void(uint8_t *, uint16_t)> d_lambda;
+    d_lambda = [&](uint8_t * buf, uint16_t len) { lambda_sum += buf[0] + len; };
+    measure("delegate (lambda)", d_lambda, count);
+
+    // Delegate with a member function
+    auto d_member = delegate<void(uint8_t *, uint16_t)>::bind<&receiver::data_handler>(&rec);
+    measure("delegate (member)", d_member, count);
+
+    // std::function with the same lambda
+    std::function<void(uint8_t *, uint16_t)> f_lambda;
+    f_lambda = [&](uint8_t * buf, uint16_t len) { lambda_sum += buf[0] + len; };
+    measure("std::function (lambda)", f_lambda, count);
+
+    // Heap usage when assigning a lambda with three captures
+    uint32_t a = 0, b = 0, c = 0;
+    allocations = 0;
+    std::function<void()> f_large = [&]() { a++; b++; c++; };
+    printf("std::function with 3 captures: %u heap allocation(s)\n", allocations);
+    // The delegate rejects this lambda at compile time if it does not
+    // fit into TUPP_DELEGATE_SIZE, so it never allocates.
+    allocations = 0;
+    delegate<void(uint8_t *, uint16_t)> d_copy = d_lambda;
+    d_copy = [&](uint8_t *, uint16_t) { a++; b++; };
+    printf("delegate with 2 captures     : %u heap allocation(s)\n", allocations);
+
+    printf("sizeof(delegate) = %zu, sizeof(std::function) = %zu\n",
+           sizeof(d_lambda), sizeof(f_lambda));
+    // Use the results
+    return (plain_sum + lambda_sum + rec.sum + a + b + c) == 42;
+}
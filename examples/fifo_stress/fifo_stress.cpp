@@ -0,0 +1,162 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Stress test for the lock-free SPSC FIFO on a Linux host.
+// A producer thread and a consumer thread hammer the same
+// FIFO, and the consumer checks that every value arrives
+// exactly once and in the correct order. Different FIFO
+// sizes are used, so that wrap-arounds happen at different
+// positions, and both the generic FIFO and the power-of-two
+// specialization are tested. The single-element methods (put/get), the bulk
+// methods (put_n/get_n) and the zero-copy methods (reserve_write/
+// commit_write, peek_read/consume, also with two spans) with varying
+// chunk sizes are tested.
+// The program returns 0 if all tests passed.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <span>
+#include <thread>
+
+#include "usb_fifo.h"
+
+using clk = std::chrono::steady_clock;
+
+enum class test_mode { SINGLE, BULK, SPAN };
+
+template<int SIZE, test_mode MODE>
+bool stress(uint32_t count) {
+    static fifo<uint32_t, SIZE> f;
+    bool ok = true;
+
+    auto start = clk::now();
+    std::thread producer([&]() {
+        uint32_t chunk[37];
+        for (uint32_t i=0; i < count; ) {
+            int n = 1;
+            if (MODE == test_mode::SPAN && (i & 1)) {
+                // Fill the reserved (wrapped) space in place
+                std::span<uint32_t> first, second;
+                n = f.reserve_write(1 + (i % 37), first, second);
+                if (n > (int)(count - i)) n = count - i;
+                for (int j=0; j < n; ++j) {
+                    int k = j - (int)first.size();
+                    (k < 0 ? first[j] : second[k]) = i + j;
+                }
+                f.commit_write(n);
+            } else if (MODE == test_mode::SPAN) {
+                // Fill the reserved space in place
+                auto span = f.reserve_write(1 + (i % 37));
+                n = span.size();
+                if (n > (int)(count - i)) n = count - i;
+                for (int j=0; j < n; ++j) span[j] = i + j;
+                f.commit_write(n);
+            } else if (MODE == test_mode::BULK) {
+                // Use different chunk sizes (1...37)
+                n = 1 + (i % 37);
+                if (n > (int)(count - i)) n = count - i;
+                for (int j=0; j < n; ++j) chunk[j] = i + j;
+                n = f.put_n(chunk, n);
+            } else {
+                n = f.put(i) ? 1 : 0;
+            }
+            if (n) {
+                i += n;
+            } else {
+                // FIFO is full, let the consumer run
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::thread consumer([&]() {
+        uint32_t chunk[23];
+        for (uint32_t i=0; i < count; ) {
+            int n;
+            if (MODE == test_mode::SPAN && (i & 1)) {
+                // Copy out and release a part of the (wrapped) data
+                std::span<uint32_t> first, second;
+                n = f.peek_read(first, second);
+                if (n > 1 + (int)(i % 23)) n = 1 + (i % 23);
+                for (int j=0; j < n; ++j) {
+                    int k = j - (int)first.size();
+                    chunk[j] = k < 0 ? first[j] : second[k];
+                }
+                f.consume(n);
+            } else if (MODE == test_mode::SPAN) {
+                // Copy out and release a part of the data
+                auto span = f.peek_read();
+                n = span.size();
+                if (n > 1 + (int)(i % 23)) n = 1 + (i % 23);
+                for (int j=0; j < n; ++j) chunk[j] = span[j];
+                f.consume(n);
+            } else if (MODE == test_mode::BULK) {
+                // Use different chunk sizes (1...23)
+                n = f.get_n(chunk, 1 + (i % 23));
+            } else {
+                n = f.get(chunk[0]) ? 1 : 0;
+            }
+            if (n) {
+                for (int j=0; j < n; ++j, ++i) {
+                    if (chunk[j] != i) {
+                        printf("  SIZE %4d: expected %u, got %u\n", SIZE, i, chunk[j]);
+                        ok = false;
+                        return;
+                    }
+                }
+            } else {
+                // FIFO is empty, let the producer run
+                std::this_thread::yield();
+            }
+            // The fill level seen by the consumer has to be sane
+            int avail = f.available_get();
+            if (avail < 0 || avail > SIZE) {
+                printf("  SIZE %4d: invalid fill level %d\n", SIZE, avail);
+                ok = false;
+                return;
+            }
+        }
+    });
+    producer.join();
+    consumer.join();
+    double s = std::chrono::duration<double>(clk::now() - start).count();
+
+    printf("SIZE %4d %-6s: %10u values  %7.2f Mvalues/s  %s\n",
+           SIZE, MODE == test_mode::SPAN ? "span" : MODE == test_mode::BULK ? "bulk" : "single", count, count / s / 1e6, ok ? "OK" : "FAILED");
+    return ok && (f.available_get() == 0);
+}
+
+int main() {
+    const uint32_t count = 5000000;
+    bool ok = true;
+    ok &= stress<2,    test_mode::SINGLE>(count / 10);
+    ok &= stress<7,    test_mode::SINGLE>(count);
+    ok &= stress<64,   test_mode::SINGLE>(count);
+    ok &= stress<256,  test_mode::SINGLE>(count);
+    ok &= stress<1000, test_mode::SINGLE>(count);
+    ok &= stress<2,    test_mode::BULK  >(count / 10);
+    ok &= stress<7,    test_mode::BULK  >(count);
+    ok &= stress<64,   test_mode::BULK  >(count);
+    ok &= stress<256,  test_mode::BULK  >(count);
+    ok &= stress<1000, test_mode::BULK  >(count);
+    ok &= stress<2,    test_mode::SPAN  >(count / 10);
+    ok &= stress<7,    test_mode::SPAN  >(count);
+    ok &= stress<64,   test_mode::SPAN  >(count);
+    ok &= stress<256,  test_mode::SPAN  >(count);
+    ok &= stress<1000, test_mode::SPAN  >(count);
+    ok &= stress<65536, test_mode::BULK  >(count);
+    printf("sizeof(fifo<uint8_t, 255>) = %zu, sizeof(fifo<uint8_t, 256>) = %zu\n",
+           sizeof(fifo<uint8_t, 255>), sizeof(fifo<uint8_t, 256>));
+    printf(ok ? "All tests passed\n" : "Test FAILED\n");
+    return ok ? 0 : 1;
+}
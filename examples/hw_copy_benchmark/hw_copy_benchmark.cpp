@@ -0,0 +1,119 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Micro-benchmark of the copy routines for the USB HW
+// buffers (usb_hw_copy.h) on a Linux host. First the
+// aligned copy routines are checked against memcpy() for
+// all lengths up to 2 packets and all alignments. Then
+// 64 byte packets are copied to/from a 64 byte aligned
+// 'HW buffer' with a byte-wise loop, the aligned routines
+// and memcpy(), for all user buffer alignments.
+// The program returns 0 if all checks passed.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "usb_hw_copy.h"
+
+using clk = std::chrono::steady_clock;
+
+// The former byte-wise copy. The HW buffer is accessed
+// through a volatile pointer, like in the aligned version.
+static void bytewise_to_hw(uint8_t * hw, const uint8_t * from, size_t n) {
+    volatile uint8_t * to = hw;
+    while (n--) *to++ = *from++;
+}
+static void bytewise_from_hw(uint8_t * to, const uint8_t * hw, size_t n) {
+    const volatile uint8_t * from = hw;
+    while (n--) *to++ = *from++;
+}
+
+alignas(64) static uint8_t hw_buffer[256];
+alignas(64) static uint8_t user_buffer[256];
+alignas(64) static uint8_t ref_buffer[256];
+
+static bool check() {
+    for (int hw_off=0; hw_off < 4; ++hw_off) {
+        for (int user_off=0; user_off < 4; ++user_off) {
+            for (int len=0; len <= 128; ++len) {
+                for (int i=0; i < 256; ++i) {
+                    user_buffer[i] = i * 7 + len;
+                    hw_buffer[i]   = ref_buffer[i] = i;
+                }
+                // To the HW buffer
+                tupp_copy_to_hw_aligned(hw_buffer + hw_off, user_buffer + user_off, len);
+                memcpy(ref_buffer + hw_off, user_buffer + user_off, len);
+                if (memcmp(hw_buffer, ref_buffer, sizeof(hw_buffer))) {
+                    printf("to_hw failed: hw+%d user+%d len %d\n", hw_off, user_off, len);
+                    return false;
+                }
+                // From the HW buffer
+                for (int i=0; i < 256; ++i) {
+                    user_buffer[i] = ref_buffer[i] = i;
+                    hw_buffer[i]   = i * 5 + len;
+                }
+                tupp_copy_from_hw_aligned(user_buffer + user_off, hw_buffer + hw_off, len);
+                memcpy(ref_buffer + user_off, hw_buffer + hw_off, len);
+                if (memcmp(user_buffer, ref_buffer, sizeof(user_buffer))) {
+                    printf("from_hw failed: hw+%d user+%d len %d\n", hw_off, user_off, len);
+                    return false;
+                }
+            }
+        }
+    }
+    printf("Aligned copy routines OK\n");
+    return true;
+}
+
+using copy_func = void (*)(uint8_t *, const uint8_t *, size_t);
+
+__attribute__((noinline))
+static void measure(const char * name, copy_func f, bool to_hw, int user_off) {
+    const uint32_t count = 2000000;
+    const size_t   len   = 64;
+    // Hide the function from the optimizer
+    asm volatile("" : "+r"(f));
+    auto start = clk::now();
+    for (uint32_t i=0; i < count; ++i) {
+        if (to_hw) {
+            f(hw_buffer, user_buffer + user_off, len);
+        } else {
+            f(user_buffer + user_off, hw_buffer, len);
+        }
+        asm volatile("" : : : "memory");
+    }
+    double s = std::chrono::duration<double>(clk::now() - start).count();
+    printf("  %-9s user+%d: %7.2f ns/packet %8.1f MB/s\n", name, user_off,
+           s * 1e9 / count, count * len / s / (1024.0 * 1024.0));
+}
+
+int main() {
+    if (!check()) {
+        printf("Test FAILED\n");
+        return 1;
+    }
+    for (int dir=0; dir < 2; ++dir) {
+        bool to_hw = (dir == 0);
+        printf("64 byte packets %s HW buffer:\n", to_hw ? "to" : "from");
+        for (int user_off=0; user_off < 4; ++user_off) {
+            measure("byte-wise", to_hw ? bytewise_to_hw : bytewise_from_hw, to_hw, user_off);
+            measure("aligned",   to_hw ? tupp_copy_to_hw_aligned : tupp_copy_from_hw_aligned, to_hw, user_off);
+            measure("memcpy",    (copy_func)[](uint8_t * to, const uint8_t * from, size_t n) {
+                                     memcpy(to, from, n);
+                                 }, to_hw, user_off);
+        }
+    }
+    return 0;
+}
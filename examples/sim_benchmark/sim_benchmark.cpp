@@ -0,0 +1,690 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Benchmark of the complete tinyUSB++ stack on a Linux host.
+// A CDC ACM device and a MSC device are enumerated by the
+// virtual host of the simulated device controller. Then the
+// CDC data path (loopback) and the MSC READ_10/WRITE_10 paths
+// are measured, as well as a vendor-specific packet producer,
+// which sends 64 byte frames with and without a copy to the
+// HW buffer, and an isochronous stream. Before the stream, the
+// ISO endpoint buffers are re-allocated in DPRAM with other
+// packet sizes, vendor requests (also with 64 KB data stages)
+// are sent to an interface, and the configuration descriptor
+// is read repeatedly like during an enumeration. The same
+// descriptors are also generated at compile time (see
+// usb_static_descriptors.h). They are compared with the
+// descriptors read by the host, or are sent by the controller
+// with TUPP_STATIC_DESCRIPTORS=1. Since the virtual host does
+// not consume any bus time, the results show the pure CPU
+// cost of the stack.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "usb_dcd.h"
+#include "usb_sim_host.h"
+#include "usb_device.h"
+#include "usb_device_controller.h"
+#include "usb_interface.h"
+#include "usb_cdc_acm_device.h"
+#include "usb_msc_bot_device.h"
+#include "usb_static_descriptors.h"
+
+using namespace TUPP;
+
+// The endpoint addresses are assigned in creation order:
+// CDC data IN/OUT, CDC control IN, MSC IN/OUT, packet producer
+// IN, ISO IN
+const uint8_t EP_CDC_IN    = 0x81;
+const uint8_t EP_CDC_OUT   = 0x01;
+const uint8_t EP_MSC_IN    = 0x83;
+const uint8_t EP_MSC_OUT   = 0x02;
+const uint8_t EP_FRAMES_IN = 0x84;
+const uint8_t EP_ISO_IN    = 0x85;
+
+// One ISO packet per frame: 48 kHz, 16 bit stereo
+const uint16_t ISO_PACKET_SIZE = 192;
+
+const uint16_t BLOCK_SIZE  = TUPP_MSC_BLOCK_SIZE;
+const uint32_t BLOCK_COUNT = 256;
+
+uint8_t ram_drive[BLOCK_COUNT][BLOCK_SIZE];
+
+// The descriptors of the benchmark device, generated at compile time
+using enum bInterfaceClass_t;
+using enum bInterfaceSubClass_t;
+using enum bInterfaceProtocol_t;
+using enum ep_attributes_t;
+
+constexpr auto static_device = STATIC::device({
+    .bcdUSB = 0x0200, .bMaxPacketSize0 = 64, .idVendor = 0x0001,
+    .idProduct = 0x0002, .iManufacturer = 1, .iProduct = 2,
+    .bNumConfigurations = 1 });
+
+constexpr auto static_config = STATIC::configuration(1, 0x80, 100, 0,
+    // CDC ACM device
+    STATIC::association({ .bFirstInterface = 0, .bInterfaceCount = 2,
+                          .bFunctionClass = IF_CLASS_CDC,
+                          .bFunctionSubClass = IF_SUBCLASS_ABSTRACT_CONTROL_MODEL }),
+    STATIC::interface({ .bInterfaceNumber = 0, .bInterfaceClass = IF_CLASS_CDC,
+                        .bInterfaceSubClass = IF_SUBCLASS_ABSTRACT_CONTROL_MODEL,
+                        .iInterface = 3 },
+        STATIC::descriptor(0x24, 0x00, 0x20, 0x01),     // Header, CDC 1.20
+        STATIC::descriptor(0x24, 0x01, 0x00, 0x01),     // Call management
+        STATIC::descriptor(0x24, 0x02, 0x06),           // ACM
+        STATIC::descriptor(0x24, 0x06, 0x00, 0x01),     // Union
+        STATIC::endpoint({ .bEndpointAddress = 0x82, .bmAttributes = TRANS_INTERRUPT,
+                           .wMaxPacketSize = 64, .bInterval = 10 })),
+    STATIC::interface({ .bInterfaceNumber = 1, .bInterfaceClass = IF_CLASS_CDC_DATA },
+        STATIC::endpoint({ .bEndpointAddress = EP_CDC_IN,  .bmAttributes = TRANS_BULK,
+                           .wMaxPacketSize = 64, .bInterval = 10 }),
+        STATIC::endpoint({ .bEndpointAddress = EP_CDC_OUT, .bmAttributes = TRANS_BULK,
+                           .wMaxPacketSize = 64, .bInterval = 10 })),
+    // MSC device
+    STATIC::interface({ .bInterfaceNumber = 2, .bInterfaceClass = IF_CLASS_MSC,
+                        .bInterfaceSubClass = IF_SUBCLASS_SCSI_TRANSPARENT,
+                        .bInterfaceProtocol = IF_PROTOCOL_MSC_BOT },
+        STATIC::endpoint({ .bEndpointAddress = EP_MSC_IN,  .bmAttributes = TRANS_BULK,
+                           .wMaxPacketSize = 64, .bInterval = 10 }),
+        STATIC::endpoint({ .bEndpointAddress = EP_MSC_OUT, .bmAttributes = TRANS_BULK,
+                           .wMaxPacketSize = 64, .bInterval = 10 })),
+    // Packet producer
+    STATIC::interface({ .bInterfaceNumber = 3, .bInterfaceClass = IF_CLASS_VENDOR_SPECIFIC },
+        STATIC::endpoint({ .bEndpointAddress = EP_FRAMES_IN, .bmAttributes = TRANS_BULK,
+                           .wMaxPacketSize = 64, .bInterval = 10 }),
+        STATIC::endpoint({ .bEndpointAddress = EP_ISO_IN, .bmAttributes = TRANS_ISOCHRONOUS,
+                           .wMaxPacketSize = ISO_PACKET_SIZE, .bInterval = 1 })));
+
+constexpr auto static_strings = STATIC::strings(0x0409,
+    "Dummy Manufacturer", "tinyUSB++ Simulation", "CDC-ACM UART Interface");
+
+constexpr STATIC::descriptor_set static_descriptors(static_device, static_config, static_strings);
+
+using clk = std::chrono::steady_clock;
+
+static double mb_per_s(uint64_t bytes, clk::duration d) {
+    double s = std::chrono::duration<double>(d).count();
+    return (double)bytes / s / (1024.0 * 1024.0);
+}
+
+// Send a SCSI command in a CBW and return the tag
+static uint32_t send_cbw(usb_sim_host & host, usb_msc_bot_device & msc,
+                         SCSI::scsi_cmd_t cmd, bool dir_in,
+                         uint32_t lba, uint16_t blocks) {
+    static uint32_t tag = 0;
+    MSC::cbw_t cbw {};
+    cbw.dCBWSignature          = MSC::cbw_signature;
+    cbw.dCBWTag                = ++tag;
+    cbw.dCBWDataTransferLength = blocks * BLOCK_SIZE;
+    cbw.direction              = dir_in ? MSC::direction_t::DIR_IN : MSC::direction_t::DIR_OUT;
+    cbw.bCBWCBLength           = sizeof(SCSI::read_10_t);
+    auto * rw = (SCSI::read_10_t *)cbw.CBWCB;
+    rw->cmd                    = cmd;
+    rw->logical_block_address  = __builtin_bswap32(lba);
+    rw->transfer_length        = __builtin_bswap16(blocks);
+    while (host.bulk_out(EP_MSC_OUT, (uint8_t *)&cbw, sizeof(cbw)) != sizeof(cbw)) {
+        msc.handle_request();
+    }
+    return tag;
+}
+
+// Receive the CSW and check its status
+static bool receive_csw(usb_sim_host & host, usb_msc_bot_device & msc, uint32_t tag) {
+    MSC::csw_t csw {};
+    int len;
+    while ((len = host.bulk_in(EP_MSC_IN, (uint8_t *)&csw, sizeof(csw))) == 0) {
+        msc.handle_request();
+    }
+    return (len == sizeof(csw)) && (csw.dCSWTag == tag) &&
+           (csw.bCSWStatus == MSC::csw_status_t::CMD_PASSED);
+}
+
+// Echo the received data with read()/write(), or
+// directly from FIFO to FIFO with the zero-copy API
+static bool cdc_loopback(usb_sim_host & host, usb_cdc_acm_device & acm,
+                         uint32_t total, bool zero_copy) {
+    uint8_t  tx[64], rx[512], echo[TUPP_CDC_ACM_FIFO_SIZE];
+    uint32_t sent = 0, received = 0;
+    uint16_t pending = 0, pending_pos = 0;
+    uint8_t  expected = 0;
+
+    host.reset_stats();
+    auto start = clk::now();
+    while (received < total) {
+        // Host sends data ...
+        if (sent < total) {
+            uint16_t n = total - sent > sizeof(tx) ? sizeof(tx) : total - sent;
+            for (uint16_t i=0; i < n; ++i) tx[i] = (uint8_t)(sent + i);
+            int res = host.bulk_out(EP_CDC_OUT, tx, n);
+            if (res < 0) return false;
+            sent += res;
+        }
+        // ... the device echoes it ...
+        if (zero_copy) {
+            auto rx_data = acm.peek_read();
+            auto tx_data = acm.reserve_write(rx_data.size());
+            memcpy(tx_data.data(), rx_data.data(), tx_data.size());
+            acm.commit_write(tx_data.size());
+            acm.consume(tx_data.size());
+        } else if (!pending) {
+            pending     = acm.read(echo, sizeof(echo));
+            pending_pos = 0;
+        }
+        if (!zero_copy && pending) {
+            uint32_t n = acm.write(echo + pending_pos, pending);
+            pending_pos += n;
+            pending     -= n;
+        }
+        // ... and the host reads it back
+        int res = host.bulk_in(EP_CDC_IN, rx, sizeof(rx));
+        if (res < 0) return false;
+        for (int i=0; i < res; ++i) {
+            if (rx[i] != expected++) {
+                printf("CDC data mismatch at byte %u\n", received + i);
+                return false;
+            }
+        }
+        received += res;
+    }
+    auto d = clk::now() - start;
+    printf(zero_copy ? "CDC zero-copy: %8u bytes  %8.2f MB/s  (naks: %u, toggle errors: %u)\n"
+                     : "CDC loopback : %8u bytes  %8.2f MB/s  (naks: %u, toggle errors: %u)\n",
+           total, mb_per_s(total, d), host.stats().naks, host.stats().toggle_errors);
+    return host.stats().toggle_errors == 0;
+}
+
+static bool msc_read(usb_sim_host & host, usb_msc_bot_device & msc, uint32_t rounds) {
+    uint8_t block[BLOCK_SIZE];
+    host.reset_stats();
+    auto start = clk::now();
+    for (uint32_t r=0; r < rounds; ++r) {
+        uint32_t tag = send_cbw(host, msc, SCSI::scsi_cmd_t::READ_10, true, 0, BLOCK_COUNT);
+        for (uint32_t b=0; b < BLOCK_COUNT; ++b) {
+            int len;
+            while ((len = host.bulk_in(EP_MSC_IN, block, BLOCK_SIZE)) == 0) {
+                msc.handle_request();
+            }
+            if (len != BLOCK_SIZE || memcmp(block, ram_drive[b], BLOCK_SIZE)) {
+                printf("MSC read error in block %u\n", b);
+                return false;
+            }
+        }
+        if (!receive_csw(host, msc, tag)) return false;
+    }
+    auto d = clk::now() - start;
+    uint64_t bytes = (uint64_t)rounds * BLOCK_COUNT * BLOCK_SIZE;
+    printf("MSC READ_10  : %8lu bytes  %8.2f MB/s  (naks: %u, toggle errors: %u)\n",
+           (unsigned long)bytes, mb_per_s(bytes, d), host.stats().naks, host.stats().toggle_errors);
+    return host.stats().toggle_errors == 0;
+}
+
+// The host sends the data stage without waiting, and the
+// MSC state machine only runs when the host receives a NAK,
+// so the NAKs count the pauses of the data stage.
+static bool msc_write(usb_sim_host & host, usb_msc_bot_device & msc, uint32_t rounds) {
+    uint8_t block[BLOCK_SIZE];
+    host.reset_stats();
+    auto start = clk::now();
+    for (uint32_t r=0; r < rounds; ++r) {
+        uint32_t tag = send_cbw(host, msc, SCSI::scsi_cmd_t::WRITE_10, false, 0, BLOCK_COUNT);
+        for (uint32_t b=0; b < BLOCK_COUNT; ++b) {
+            memset(block, (uint8_t)(b + r), BLOCK_SIZE);
+            uint16_t sent = 0;
+            while (sent < BLOCK_SIZE) {
+                int len = host.bulk_out(EP_MSC_OUT, block + sent, BLOCK_SIZE - sent);
+                if (len < 0) return false;
+                sent += len;
+                if (sent < BLOCK_SIZE) msc.handle_request();
+            }
+        }
+        msc.handle_request();
+        if (!receive_csw(host, msc, tag)) return false;
+        if (ram_drive[BLOCK_COUNT-1][0] != (uint8_t)(BLOCK_COUNT - 1 + r)) {
+            printf("MSC write error\n");
+            return false;
+        }
+    }
+    auto d = clk::now() - start;
+    uint64_t bytes = (uint64_t)rounds * BLOCK_COUNT * BLOCK_SIZE;
+    printf("MSC WRITE_10 : %8lu bytes  %8.2f MB/s  (naks: %u, toggle errors: %u)\n",
+           (unsigned long)bytes, mb_per_s(bytes, d), host.stats().naks, host.stats().toggle_errors);
+    return host.stats().toggle_errors == 0;
+}
+
+// Fill a 64 byte frame with aligned word writes
+static void make_frame(uint32_t * frame, uint32_t seq) {
+    for (uint32_t i=0; i < 16; ++i) frame[i] = seq * 16 + i;
+}
+
+// Send 64 byte frames from the packet producer, which are
+// generated in a user buffer (and copied to the HW buffer),
+// or directly in the HW buffer
+static bool frames(usb_sim_host & host, usb_endpoint * ep,
+                   uint32_t count, bool in_place) {
+    static uint32_t frame[16];
+    uint32_t rx[16];
+    uint32_t produced = 0;
+
+    host.reset_stats();
+    auto start = clk::now();
+    for (uint32_t seq=0; seq < count; ++seq) {
+        // The device produces the next frame ...
+        if (!ep->is_active() && produced < count) {
+            if (in_place) {
+                make_frame((uint32_t *)ep->hw_buffer().data(), produced++);
+                ep->start_hw_transfer(sizeof(frame));
+            } else {
+                make_frame(frame, produced++);
+                ep->start_transfer((uint8_t *)frame, sizeof(frame));
+            }
+        }
+        // ... and the host reads it
+        int res = host.bulk_in(EP_FRAMES_IN, (uint8_t *)rx, sizeof(rx));
+        if (res != sizeof(rx) || rx[0] != seq * 16 || rx[15] != seq * 16 + 15) {
+            printf("Frame error in frame %u\n", seq);
+            return false;
+        }
+    }
+    auto d = clk::now() - start;
+    uint64_t bytes = (uint64_t)count * sizeof(frame);
+    printf(in_place ? "Frames HW buf: %8lu bytes  %8.2f MB/s  (naks: %u, toggle errors: %u)\n"
+                    : "Frames copied: %8lu bytes  %8.2f MB/s  (naks: %u, toggle errors: %u)\n",
+           (unsigned long)bytes, mb_per_s(bytes, d), host.stats().naks, host.stats().toggle_errors);
+    return host.stats().toggle_errors == 0;
+}
+
+// Reconfigure the ISO endpoint like for the bandwidth alternate
+// settings of an audio device: Zero bandwidth (buffer released),
+// max. bandwidth with double-buffering and back to the normal
+// packet size. The DPRAM usage has to be the same afterwards.
+static bool dpram_reconfig(usb_dcd & driver, usb_endpoint * ep) {
+    auto & dpram = driver.dpram();
+    size_t used = dpram.used();
+    bool ok = ep->set_packet_size(0) && (dpram.used() == used - ISO_PACKET_SIZE);
+    ok &= ep->set_packet_size(1023) && ep->set_double_buffered(true);
+    ok &= (dpram.used() == used - ISO_PACKET_SIZE + 2048);
+    ok &= ep->set_double_buffered(false) && ep->set_packet_size(ISO_PACKET_SIZE);
+    ok &= (dpram.used() == used) && (ep->descriptor.wMaxPacketSize == ISO_PACKET_SIZE);
+    printf("DPRAM        : %zu of %zu bytes used (max. %zu), largest free block %zu bytes\n",
+           dpram.used(), dpram.capacity(), dpram.high_water(), dpram.largest_free());
+    if (!ok) printf("DPRAM reconfiguration failed\n");
+    return ok;
+}
+
+// Read a descriptor with the maximum length
+static int get_descriptor(usb_sim_host & host, bDescriptorType_t type,
+                          uint8_t index, uint8_t * buf) {
+    auto pkt = usb_sim_host::make_setup(direction_t::DIR_IN, type_t::TYPE_STANDARD,
+                                        recipient_t::REC_DEVICE,
+                                        (uint8_t)bRequest_t::REQ_GET_DESCRIPTOR,
+                                        ((uint16_t)type << 8) | index, 0, TUPP_MAX_DESC_SIZE);
+    return host.control_in(pkt, buf);
+}
+
+// Compare the descriptors read by the host with
+// the descriptors generated at compile time
+static bool static_descriptors_check(usb_sim_host & host) {
+    uint8_t buf[TUPP_MAX_DESC_SIZE];
+    auto equal = [&](int len, const uint8_t * desc) {
+        return desc && (len == STATIC::descriptor_set::length(desc)) &&
+               !memcmp(buf, desc, len);
+    };
+    bool ok = equal(get_descriptor(host, bDescriptorType_t::DESC_DEVICE, 0, buf),
+                    static_descriptors.device());
+    ok &= equal(get_descriptor(host, bDescriptorType_t::DESC_CONFIGURATION, 0, buf),
+                static_descriptors.configuration(0));
+    for (uint8_t i=0; i < 4; ++i) {
+        ok &= equal(get_descriptor(host, bDescriptorType_t::DESC_STRING, i, buf),
+                    static_descriptors.string(i));
+    }
+    printf("Static desc. : %s (%zu bytes in flash)\n", ok ? "match" : "MISMATCH",
+           sizeof(static_device) + sizeof(static_config) + sizeof(static_strings.data));
+    return ok;
+}
+
+// Send vendor requests to the packet producer interface, like
+// a calibration protocol. Each request is answered with a
+// sequence number by the setup handler of the interface.
+static bool vendor_requests(usb_sim_host & host, usb_device_controller & controller,
+                            usb_interface & uif, uint32_t requests) {
+    uint32_t seq = 0;
+    uif.setup_handler = [&](setup_packet_t *) {
+        seq++;
+        controller._ep0_in->start_transfer((uint8_t *)&seq, sizeof(seq));
+    };
+    auto pkt = usb_sim_host::make_setup(direction_t::DIR_IN, type_t::TYPE_VENDOR,
+                                        recipient_t::REC_INTERFACE, 0x42, 0,
+                                        uif.descriptor.bInterfaceNumber, sizeof(seq));
+    auto start = clk::now();
+    for (uint32_t i=1; i <= requests; ++i) {
+        uint32_t rx = 0;
+        if (host.control_in(pkt, (uint8_t *)&rx) != sizeof(rx) || rx != i) {
+            printf("Vendor request error in request %u\n", i);
+            uif.setup_handler = nullptr;
+            return false;
+        }
+    }
+    auto d = clk::now() - start;
+    uif.setup_handler = nullptr;
+    double us = std::chrono::duration<double, std::micro>(d).count() / requests;
+    printf("Vendor req.  : %8u requests %6.2f us/request\n", requests, us);
+    return true;
+}
+
+// Push blobs of 64 KB - 1 with vendor control OUT requests to
+// the packet producer interface. The data stage is streamed to a
+// checksum in chunks of 512 bytes. The last blob is rejected by
+// the handler, so the host has to see a stalled request.
+struct blob_sink {
+    usb_device_controller & controller;
+    uint8_t  chunk[512];
+    uint32_t sum {0};
+    uint16_t next_offset {0};
+    bool     reject {false};
+
+    bool data(const uint8_t * data, uint16_t len, uint16_t offset) {
+        if (reject || offset != next_offset) return false;
+        for (uint16_t i=0; i < len; ++i) sum += data[i];
+        next_offset += len;
+        return true;
+    }
+    void setup(setup_packet_t * pkt) {
+        next_offset = 0;
+        controller.receive_control_data(pkt, chunk, sizeof(chunk),
+            usb_device_controller::stream_handler_t::bind<&blob_sink::data>(this));
+    }
+};
+
+static bool control_out_blobs(usb_sim_host & host, usb_device_controller & controller,
+                              usb_interface & uif, uint32_t blobs) {
+    static uint8_t blob[65535];
+    uint32_t expected = 0;
+    for (uint32_t i=0; i < sizeof(blob); ++i) {
+        blob[i] = (uint8_t)(i * 13);
+        expected += blob[i];
+    }
+    blob_sink sink { controller };
+    uif.setup_handler =
+        delegate<void(setup_packet_t *)>::bind<&blob_sink::setup>(&sink);
+    auto pkt = usb_sim_host::make_setup(direction_t::DIR_OUT, type_t::TYPE_VENDOR,
+                                        recipient_t::REC_INTERFACE, 0x43, 0,
+                                        uif.descriptor.bInterfaceNumber, sizeof(blob));
+    bool ok = true;
+    auto start = clk::now();
+    for (uint32_t i=0; i < blobs && ok; ++i) {
+        sink.sum = 0;
+        ok = (host.control_out(pkt, blob) == sizeof(blob)) && (sink.sum == expected);
+    }
+    auto d = clk::now() - start;
+    // A rejected blob stalls the request
+    sink.reject = true;
+    ok &= host.control_out(pkt, blob) < 0;
+    uif.setup_handler = nullptr;
+    uint64_t bytes = (uint64_t)blobs * sizeof(blob);
+    printf("Control OUT  : %8lu bytes  %8.2f MB/s  (%u blobs)\n",
+           (unsigned long)bytes, mb_per_s(bytes, d), blobs);
+    if (!ok) printf("Control OUT data error\n");
+    return ok;
+}
+
+// Read the configuration descriptor like a host does during
+// enumeration (header first, then the complete tree). A change
+// of the ISO packet size has to be visible in the next read.
+static bool config_descriptor(usb_sim_host & host, usb_endpoint * ep, uint32_t reads) {
+    uint8_t buf[TUPP_MAX_DESC_SIZE];
+    auto get_config = [&](uint16_t len) {
+        auto pkt = usb_sim_host::make_setup(direction_t::DIR_IN, type_t::TYPE_STANDARD,
+                                            recipient_t::REC_DEVICE,
+                                            (uint8_t)bRequest_t::REQ_GET_DESCRIPTOR,
+                                            (uint16_t)bDescriptorType_t::DESC_CONFIGURATION << 8,
+                                            0, len);
+        return host.control_in(pkt, buf);
+    };
+    // Find the wMaxPacketSize of the ISO endpoint in the tree
+    auto iso_packet_size = [&](uint16_t total) {
+        for (uint16_t i=0; i < total; i += buf[i]) {
+            auto * desc = (endpoint_descriptor_t *)(buf + i);
+            if (desc->bDescriptorType == bDescriptorType_t::DESC_ENDPOINT &&
+                desc->bEndpointAddress == EP_ISO_IN) {
+                return (int)desc->wMaxPacketSize;
+            }
+        }
+        return -1;
+    };
+    if (get_config(sizeof(configuration_descriptor_t)) != sizeof(configuration_descriptor_t)) {
+        return false;
+    }
+    uint16_t total = ((configuration_descriptor_t *)buf)->wTotalLength;
+
+    auto start = clk::now();
+    for (uint32_t i=0; i < reads; ++i) {
+        if (get_config(total) != total) {
+            printf("Configuration descriptor error\n");
+            return false;
+        }
+    }
+    auto d = clk::now() - start;
+    bool ok = iso_packet_size(total) == ISO_PACKET_SIZE;
+#if !TUPP_STATIC_DESCRIPTORS
+    // Modify the tree and read it again
+    ok &= ep->set_packet_size(ISO_PACKET_SIZE / 2);
+    ok &= (get_config(total) == total) && (iso_packet_size(total) == ISO_PACKET_SIZE / 2);
+    ok &= ep->set_packet_size(ISO_PACKET_SIZE);
+    ok &= (get_config(total) == total) && (iso_packet_size(total) == ISO_PACKET_SIZE);
+#else
+    (void)ep;
+#endif
+    double us = std::chrono::duration<double, std::micro>(d).count() / reads;
+    printf("Config desc. : %8u reads   %8.2f us/read  (%u bytes)\n", reads, us, total);
+    if (!ok) printf("Configuration descriptor not updated\n");
+    return ok;
+}
+
+// Sample source of the ISO stream. The next packet is
+// armed in the IRQ context when the previous one is sent.
+struct iso_source {
+    usb_endpoint * ep;
+    uint32_t       produced {0};
+    bool           running  {true};
+    uint8_t        packet[ISO_PACKET_SIZE];
+
+    void next() {
+        memset(packet, (uint8_t)++produced, sizeof(packet));
+        ep->start_transfer(packet, sizeof(packet));
+    }
+    void data_handler(uint8_t *, uint16_t) {
+        if (running) next();
+    }
+};
+
+// Stream ISO packets for the given number of frames. Then the
+// source pauses for some frames, which have to be reported as
+// missed frames by the device and as lost packets by the host.
+// All frames are also counted with the SOF interrupt, and the
+// frame number is checked with a SYNCH_FRAME request.
+static bool iso_stream(usb_sim_host & host, usb_dcd & driver,
+                       usb_endpoint * ep, uint32_t frames) {
+    const uint32_t PAUSE = 3;
+    iso_source src { ep };
+    uint8_t rx[ISO_PACKET_SIZE];
+    ep->data_handler =
+        delegate<void(uint8_t *, uint16_t)>::bind<&iso_source::data_handler>(&src);
+    uint32_t sofs = 0;
+    driver.sof_handler = [&](uint16_t) { sofs++; };
+    driver.sof_enable(true);
+
+    host.reset_stats();
+    ep->reset_iso_stats();
+    src.next();
+    auto start = clk::now();
+    for (uint32_t f=0; f < frames; ++f) {
+        host.sof();
+        int res = host.iso_in(EP_ISO_IN, rx, sizeof(rx));
+        if (res != sizeof(rx) || rx[0] != (uint8_t)(f + 1)) {
+            printf("ISO error in frame %u\n", f);
+            return false;
+        }
+    }
+    auto d = clk::now() - start;
+    // Send the last armed packet and pause
+    src.running = false;
+    for (uint32_t f=0; f <= PAUSE; ++f) {
+        host.sof();
+        host.iso_in(EP_ISO_IN, rx, sizeof(rx));
+    }
+    // Restart the stream
+    src.running = true;
+    src.next();
+    host.sof();
+    if (host.iso_in(EP_ISO_IN, rx, sizeof(rx)) != sizeof(rx)) return false;
+    ep->data_handler = nullptr;
+    driver.sof_enable(false);
+    driver.sof_handler = nullptr;
+
+    uint16_t frame = 0;
+    auto pkt = usb_sim_host::make_setup(direction_t::DIR_IN, type_t::TYPE_STANDARD,
+                                        recipient_t::REC_ENDPOINT,
+                                        (uint8_t)bRequest_t::REQ_SYNCH_FRAME,
+                                        0, EP_ISO_IN, 2);
+    if ((host.control_in(pkt, (uint8_t *)&frame) != 2) || (frame != host.frame()) ||
+        (sofs != frames + PAUSE + 2)) {
+        printf("SOF/SYNCH_FRAME error (frame %u, SOFs %u)\n", frame, sofs);
+        return false;
+    }
+
+    auto stats = ep->iso_stats();
+    uint64_t bytes = (uint64_t)frames * ISO_PACKET_SIZE;
+    printf("ISO stream   : %8lu bytes  %8.2f MB/s  (missed frames: %u, host drops: %u)\n",
+           (unsigned long)bytes, mb_per_s(bytes, d), stats.missed_frames, host.stats().iso_drops);
+    return (stats.missed_frames == PAUSE) && (host.stats().iso_drops == PAUSE) &&
+           (host.stats().toggle_errors == 0);
+}
+
+int main() {
+#if TUPP_DUAL_CORE
+    // The USB stack is set up on (simulated) core 1,
+    // so the USB interrupt is handled by this core
+    usb_dcd_hw::_core = 1;
+#endif
+    // USB Device driver
+    usb_dcd & driver = usb_dcd::inst();
+#if TUPP_DEFERRED_EVENTS
+    // Count the wake-ups of the USB task. The simulation
+    // runs the task after every interrupt anyway.
+    uint32_t notifications = 0;
+    driver.events_pending_handler = [&]() { ++notifications; };
+#endif
+    // USB device: Root object of USB descriptor tree
+    usb_device device;
+    // Put generic USB Device Controller on top
+#if TUPP_STATIC_DESCRIPTORS
+    usb_device_controller controller(driver, device, static_descriptors);
+#else
+    usb_device_controller controller(driver, device);
+#endif
+
+    // USB device descriptor
+    device.set_bcdUSB         (0x0200);
+    device.set_bMaxPacketSize0(64);
+    device.set_idVendor       (0x0001);
+    device.set_idProduct      (0x0002);
+    device.set_Manufacturer   ("Dummy Manufacturer");
+    device.set_Product        ("tinyUSB++ Simulation");
+
+    // USB configuration descriptor
+    usb_configuration config(device);
+    config.set_bConfigurationValue(1);
+    config.set_bmAttributes( { .remote_wakeup = 0,
+                               .self_powered  = 0,
+                               .bus_powered   = 1 } );
+    config.set_bMaxPower_mA(100);
+
+    // USB CDC ACM device
+    usb_cdc_acm_device acm_device(controller, config);
+
+    // MSC device
+    usb_msc_bot_device msc_device(controller, config);
+    msc_device.capacity_handler = [&](uint16_t & block_size,
+                                      uint32_t & block_count) {
+        block_size  = BLOCK_SIZE;
+        block_count = BLOCK_COUNT;
+    };
+    msc_device.read_handler = [&](uint8_t * buff, uint32_t block) {
+        memcpy(buff, ram_drive[block], BLOCK_SIZE);
+        return 0;
+    };
+    msc_device.write_handler = [&](uint8_t * buff, uint32_t block) {
+        memcpy(ram_drive[block], buff, BLOCK_SIZE);
+        return 0;
+    };
+    for (uint32_t b=0; b < BLOCK_COUNT; ++b) {
+        memset(ram_drive[b], (uint8_t)(b * 7), BLOCK_SIZE);
+    }
+
+    // Vendor-specific packet producer with one bulk IN endpoint
+    usb_interface frames_if(config);
+    frames_if.set_bInterfaceClass(bInterfaceClass_t::IF_CLASS_VENDOR_SPECIFIC);
+    usb_endpoint * ep_frames =
+        controller.create_endpoint(frames_if, EP_FRAMES_IN, ep_attributes_t::TRANS_BULK);
+    usb_endpoint * ep_iso =
+        controller.create_endpoint(frames_if, EP_ISO_IN, ep_attributes_t::TRANS_ISOCHRONOUS,
+                                   ISO_PACKET_SIZE, 1);
+
+    // Activate USB device and let the virtual host enumerate it
+    driver.pullup_enable(true);
+    usb_sim_host host(driver);
+    if (!host.enumerate() || !controller.active_configuration) {
+        printf("Enumeration failed\n");
+        return 1;
+    }
+    printf("Enumeration OK (address %d)\n", host.address());
+    auto & pool = driver.endpoint_pool();
+    printf("Endpoint pool: %d of %d endpoints used (%zu bytes)\n",
+           pool.high_water(), pool.capacity(), pool.size_bytes());
+
+    bool ok = static_descriptors_check(host);
+#if TUPP_DUAL_CORE
+    // The application uses the CDC and MSC devices on core 0
+    usb_dcd_hw::_core = 0;
+#endif
+    ok &= cdc_loopback(host, acm_device, 16 * 1024 * 1024, false);
+    ok &= cdc_loopback(host, acm_device, 16 * 1024 * 1024, true);
+    ok &= msc_read    (host, msc_device, 64);
+    ok &= msc_write   (host, msc_device, 64);
+#if TUPP_DUAL_CORE
+    usb_dcd_hw::_core = 1;
+#endif
+    ok &= frames      (host, ep_frames, 1024 * 1024, false);
+    ok &= frames      (host, ep_frames, 1024 * 1024, true);
+    ok &= dpram_reconfig(driver, ep_iso);
+    ok &= vendor_requests(host, controller, frames_if, 100000);
+    ok &= control_out_blobs(host, controller, frames_if, 256);
+    ok &= config_descriptor(host, ep_iso, 100000);
+    ok &= iso_stream  (host, driver, ep_iso, 1024 * 1024);
+#if TUPP_IRQ_CYCLE_STATS
+    auto & irq = driver.irq_stats();
+    printf("IRQ handler  : %u interrupts, %.1f cycles avg., %u cycles max.\n",
+           irq.count, (double)irq.total / irq.count, irq.max);
+    printf("IRQ latency  : %u events, %.1f cycles avg., %u cycles max. (%s)\n",
+           irq.events, (double)irq.latency_total / irq.events, irq.latency_max,
+           TUPP_DEFERRED_EVENTS ? "deferred" : "in IRQ");
+#endif
+#if TUPP_DEFERRED_EVENTS
+    printf("Notifications: %u task wake-ups\n", notifications);
+    ok &= notifications > 0;
+#endif
+    printf(ok ? "All benchmarks passed\n" : "Benchmark FAILED\n");
+    return ok ? 0 : 1;
+}
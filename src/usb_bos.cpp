@@ -55,7 +55,8 @@ usb_bos::usb_bos(usb_device_controller & controller, usb_device & device)
                 for (size_t i=0; i < size; ++i) {
                     *_buffer_ptr++ = _ms_header->desc_getNext();
                 }
-                controller._ep0_in->start_transfer(_buffer, size);
+                if (size > pkt->wLength) size = pkt->wLength;
+                controller._ep0_in->start_transfer(_buffer, size, size < pkt->wLength);
             } else {
                 controller._ep0_in->send_stall(true);
                 controller._ep0_out->send_stall(true);
@@ -67,7 +68,7 @@ usb_bos::usb_bos(usb_device_controller & controller, usb_device & device)
             if (pkt->wValue) {
                 uint8_t len = usb_strings::inst.prepare_url_utf8(pkt->wValue, _url_format, _buffer);
                 if (len > pkt->wLength) len = pkt->wLength;
-                controller._ep0_in->start_transfer(_buffer, len);
+                controller._ep0_in->start_transfer(_buffer, len, len < pkt->wLength);
             } else {
                 controller._ep0_in->send_stall(true);
                 controller._ep0_out->send_stall(true);
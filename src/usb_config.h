@@ -26,6 +26,14 @@
 #define TUPP_MAX_DESC_SIZE 256
 #endif
 
+// Use constant descriptors, which are generated at compile
+// time and stored in flash (see usb_static_descriptors.h).
+// The usb_device_controller sends them without a copy, and
+// the RAM buffers for the descriptors are not needed.
+#ifndef TUPP_STATIC_DESCRIPTORS
+#define TUPP_STATIC_DESCRIPTORS 0
+#endif
+
 // Maximum number of USB configurations per USB device
 #ifndef TUPP_MAX_CONF_PER_DEVICE
 #define TUPP_MAX_CONF_PER_DEVICE 5
@@ -46,6 +54,55 @@
 #define TUPP_MAX_EP_PER_INTERFACE 5
 #endif
 
+// Maximum number of endpoints (including EP0 IN/OUT)
+// in the static endpoint pool of a driver. The HW
+// supports up to 16 IN and 16 OUT endpoints.
+#ifndef TUPP_MAX_ENDPOINTS
+#define TUPP_MAX_ENDPOINTS 32
+#endif
+
+// Measure the CPU cycles spent in the USB interrupt
+// handler (see usb_dcd::irq_stats()). On the RP2040
+// this uses the SysTick timer, on the RP2350 the DWT
+// cycle counter, in the simulation the x86 TSC.
+#ifndef TUPP_IRQ_CYCLE_STATS
+#define TUPP_IRQ_CYCLE_STATS 0
+#endif
+
+// Deferred event mode: The USB interrupt handler only
+// records the USB events in a lock-free queue, and all
+// handlers are called by usb_dcd::process_events(), e.g.
+// in a RTOS task, which is woken up by the handler
+// usb_dcd::events_pending_handler. By default, the
+// handlers are called directly in the IRQ context.
+#ifndef TUPP_DEFERRED_EVENTS
+#define TUPP_DEFERRED_EVENTS 0
+#endif
+
+// Size of the event queue in deferred event mode.
+// One interrupt records up to 5 events (SOF, SETUP, bus
+// reset, buffers and cross-core calls), and it only runs
+// if 5 entries are free. So the minimum size is 6 (one
+// entry is unused if the size is not a power of two).
+#ifndef TUPP_EVENT_QUEUE_SIZE
+#define TUPP_EVENT_QUEUE_SIZE 16
+#endif
+
+// Dual-core mode: The USB interrupt and the class state
+// machines run on one core, and the application uses the
+// classes from the other core. All endpoint accesses of the
+// application are then handed over to the USB core (see
+// usb_dcd_interface::call_on_usb_core()).
+#ifndef TUPP_DUAL_CORE
+#define TUPP_DUAL_CORE 0
+#endif
+
+// Size of the queue for calls handed over
+// to the USB core in dual-core mode
+#ifndef TUPP_CALL_QUEUE_SIZE
+#define TUPP_CALL_QUEUE_SIZE 8
+#endif
+
 // Default packet size for USB endpoints
 #ifndef TUPP_DEFAULT_PAKET_SIZE
 #define TUPP_DEFAULT_PAKET_SIZE 64
@@ -56,6 +113,27 @@
 #define TUPP_DEFAULT_POLL_INTERVAL 10
 #endif
 
+// Number of transfers which can be queued per endpoint
+// (see usb_endpoint::queue_transfer). If this is not
+// a power of two, one entry less can be used.
+#ifndef TUPP_EP_QUEUE_DEPTH
+#define TUPP_EP_QUEUE_DEPTH 4
+#endif
+
+// Maximum number of segments in a scatter-gather
+// transfer (see usb_endpoint::start_transfer), e.g.
+// a header and the two parts of a wrapped FIFO.
+#ifndef TUPP_MAX_SEGMENTS
+#define TUPP_MAX_SEGMENTS 3
+#endif
+
+// Size of the storage for a callable object in a
+// delegate (see usb_delegate.h). The default is
+// sufficient for lambdas with two captured references.
+#ifndef TUPP_DELEGATE_SIZE
+#define TUPP_DELEGATE_SIZE (2 * sizeof(void *))
+#endif
+
 // Default number of capabilities in BOS descriptor
 #ifndef TUPP_MAX_BOS_CAPABILITIES
 #define TUPP_MAX_BOS_CAPABILITIES 2
@@ -81,7 +159,8 @@
 #define TUPP_MAX_MS_CHILDREN 10
 #endif
 
-// Default size of CDC ACM FIFOs
+// Default size of CDC ACM FIFOs. A power of two
+// selects the faster FIFO implementation.
 #ifndef TUPP_CDC_ACM_FIFO_SIZE
 #define TUPP_CDC_ACM_FIFO_SIZE 256
 #endif
@@ -91,13 +170,32 @@
 #define TUPP_MSC_BLOCK_SIZE 512
 #endif
 
-// Use a byte-wise memcpy function for copying
-// data to/from the USB HW buffers. This is
-// needed by some platforms (e.g. RP2350), because
-// unaligned word/half-word accesses to the USB RAM
-// result in a hard fault...
-#ifndef TUPP_USE_BYTEWISE_MEMCPY
-#define TUPP_USE_BYTEWISE_MEMCPY 0
+// Maximum number of blocks received in one OUT transfer
+// during a MSC WRITE_10 command (size of each of the two
+// OUT buffers). Larger commands are received in chunks of
+// this size, alternating between the buffers, so the next
+// chunk is received while the previous one is written.
+#ifndef TUPP_MSC_WRITE_BLOCKS
+#define TUPP_MSC_WRITE_BLOCKS 4
+#endif
+
+// Use double-buffered bulk endpoints for MSC devices
+#ifndef TUPP_MSC_DOUBLE_BUFFERED
+#define TUPP_MSC_DOUBLE_BUFFERED 0
+#endif
+
+// Use an alignment-aware copy function for copying
+// data to/from the USB HW buffers (see usb_hw_copy.h).
+// This is needed by some platforms (e.g. RP2350),
+// because unaligned word/half-word accesses to the
+// USB RAM result in a hard fault...
+// TUPP_USE_BYTEWISE_MEMCPY is the former name of this
+// option and is still accepted.
+#if defined(TUPP_USE_BYTEWISE_MEMCPY) && !defined(TUPP_USE_ALIGNED_MEMCPY)
+#define TUPP_USE_ALIGNED_MEMCPY (TUPP_USE_BYTEWISE_MEMCPY)
+#endif
+#ifndef TUPP_USE_ALIGNED_MEMCPY
+#define TUPP_USE_ALIGNED_MEMCPY 0
 #endif
 
 #endif // _TUPP_USB_CONFIG_H
@@ -18,13 +18,15 @@
 #include "usb_log.h"
 #include "usb_strings.h"
 #include <cassert>
+#include <cstring>
 
 using namespace TUPP;
 using enum usb_log::log_level;
 
 usb_configuration::usb_configuration(usb_device & device)
 : descriptor(_descriptor), interfaces(_interfaces),
- _descriptor{},           _interfaces{nullptr}, _associations{nullptr}
+ _descriptor{},           _interfaces{nullptr}, _associations{nullptr},
+ _dirty(true)
 {
     TUPP_LOG(LOG_DEBUG, "usb_configuration() @%x", this);
     // Set descriptor length
@@ -40,11 +42,13 @@ usb_configuration::usb_configuration(usb_device & device)
 void usb_configuration::set_Description(const char * n) {
     TUPP_LOG(LOG_DEBUG, "set_Description(%s)", n);
     _descriptor.iConfiguration = usb_strings::inst.add_string(n);
+    update_descriptor();
 }
 
 void usb_configuration::set_remote_wakeup(bool b) {
     TUPP_LOG(LOG_DEBUG, "set_remote_wakeup(%b)", b);
     _descriptor.bmAttributes.remote_wakeup = b;
+    update_descriptor();
 }
 
 void usb_configuration::set_total_length() {
@@ -65,8 +69,56 @@ void usb_configuration::set_total_length() {
         }
     }
     _descriptor.wTotalLength = len;
+    set_dirty();
 }
 
+void usb_configuration::patch_descriptor(uint16_t offset, const void * desc, uint8_t len) {
+#if !TUPP_STATIC_DESCRIPTORS
+    // If the tree has to be serialized anyway, the
+    // modified descriptor will be copied then
+    if (!_dirty) {
+        assert(offset + len <= _descriptor.wTotalLength);
+        memcpy(_blob + offset, desc, len);
+    }
+#else
+    (void)offset;
+    (void)desc;
+    (void)len;
+#endif
+}
+
+uint16_t usb_configuration::prepare_descriptor(uint8_t * blob) {
+    // Copy our own descriptor first
+    memcpy(blob, &_descriptor, sizeof(configuration_descriptor_t));
+    uint16_t offset = sizeof(configuration_descriptor_t);
+    // Copy interface and endpoint descriptors in wire order.
+    // All descriptors remember their offset for patching.
+    for (usb_interface *interface : _interfaces) {
+        if (interface) {
+            offset += interface->prepare_descriptor(blob, offset);
+        }
+    }
+    assert(offset == _descriptor.wTotalLength);
+    return offset;
+}
+
+#if !TUPP_STATIC_DESCRIPTORS
+std::span<const uint8_t> usb_configuration::get_descriptor_blob() {
+    if (_dirty) {
+        TUPP_LOG(LOG_DEBUG, "get_descriptor_blob(): serializing");
+        prepare_descriptor(_blob);
+        _dirty = false;
+    }
+    return { _blob, _descriptor.wTotalLength };
+}
+#else
+bool usb_configuration::matches_descriptor(const uint8_t * desc, uint16_t len) {
+    uint8_t blob[TUPP_MAX_DESC_SIZE];
+    return len == _descriptor.wTotalLength &&
+           prepare_descriptor(blob) == len && !memcmp(blob, desc, len);
+}
+#endif
+
 uint8_t usb_configuration::add_interface(usb_interface * interface) {
     TUPP_LOG(LOG_DEBUG, "add_interface()");
     int i = 0;
@@ -81,7 +133,7 @@ uint8_t usb_configuration::add_interface(usb_interface * interface) {
     interface->_descriptor.bInterfaceNumber = i;
     // Set our own descriptor accordingly
     _descriptor.bNumInterfaces = i + 1;
-    set_total_length();
+    add_total_length(interface->get_total_desc_length());
     return i;
 }
 
@@ -95,7 +147,8 @@ void usb_configuration::add_interface_association(usb_interface_association * as
         }
     }
     assert(i != 5);
-    set_total_length();
+    // The association descriptor is counted in the total
+    // length when its first interface is added
 }
 
 void usb_configuration::activate_endpoints(bool b) {
@@ -25,6 +25,7 @@ class usb_interface_association;
 #include "usb_structs.h"
 #include "usb_config.h"
 #include <array>
+#include <span>
 
 class usb_configuration {
 public:
@@ -37,12 +38,15 @@ public:
     // Methods to modify the device descriptor
     inline void set_bConfigurationValue(uint8_t n) {
         _descriptor.bConfigurationValue = n;
+        update_descriptor();
     }
     inline void set_bmAttributes(TUPP::conf_attr_t n) {
         _descriptor.bmAttributes = n;
+        update_descriptor();
     }
     inline void set_bMaxPower_mA(uint8_t n) {
         _descriptor.bMaxPower = n/2;
+        update_descriptor();
     }
     void set_Description(const char *);
     void set_remote_wakeup(bool b);
@@ -51,6 +55,47 @@ public:
     // descriptor and modify our descriptor accordingly
     void set_total_length();
 
+    // Add len bytes to the total length of our configuration
+    // descriptor, after a descriptor has been added to the tree
+    inline void add_total_length(uint16_t len) {
+        _descriptor.wTotalLength += len;
+        set_dirty();
+    }
+
+    // Mark the serialized descriptor as outdated, because
+    // the structure of the tree has changed (a descriptor
+    // has been added). It is serialized again on next use.
+    inline void set_dirty() {
+        _dirty = true;
+    }
+
+    // Copy a modified descriptor of the tree (len bytes) to its
+    // position (offset) in the serialized descriptor. This is
+    // called by all setters in the descriptor tree of this
+    // configuration (interfaces, endpoints, ...).
+    void patch_descriptor(uint16_t offset, const void * desc, uint8_t len);
+
+    // Serialize the complete configuration descriptor including
+    // all interface, functional and endpoint descriptors in wire
+    // order to blob (TUPP_MAX_DESC_SIZE bytes). Return the length.
+    uint16_t prepare_descriptor(uint8_t * blob);
+
+#if !TUPP_STATIC_DESCRIPTORS
+    // Return the complete configuration descriptor including
+    // all interface, functional and endpoint descriptors
+    // (descriptor.wTotalLength bytes). The descriptors are
+    // stored contiguously in wire order. They are serialized
+    // once, and setters patch them in place afterwards, so
+    // the tree is only walked again after it has been extended.
+    std::span<const uint8_t> get_descriptor_blob();
+#else
+    // Check that a constant configuration descriptor (len bytes)
+    // is identical to the serialized descriptor tree. The requests
+    // are routed with the tree, so both have to describe the same
+    // interfaces and endpoints.
+    bool matches_descriptor(const uint8_t * desc, uint16_t len);
+#endif
+
     // Read-only version of our descriptor
     const TUPP::configuration_descriptor_t & descriptor;
 
@@ -68,6 +113,11 @@ public:
     void add_interface_association(usb_interface_association * function);
 
 private:
+    // Patch our own descriptor in the serialized descriptor
+    inline void update_descriptor() {
+        patch_descriptor(0, &_descriptor, sizeof(_descriptor));
+    }
+
     // The configuration descriptor
     TUPP::configuration_descriptor_t _descriptor;
 
@@ -76,6 +126,14 @@ private:
 
     // Array of pointers to our interface associations
     std::array<usb_interface_association *, TUPP_MAX_ASSOC_PER_CONF> _associations;
+
+#if !TUPP_STATIC_DESCRIPTORS
+    // The serialized descriptor tree
+    uint8_t _blob[TUPP_MAX_DESC_SIZE] {};
+#endif
+    // Flag showing that the tree has to be serialized again
+    // (the positions of the descriptors are not known)
+    bool    _dirty;
 };
 
 #endif  // TUPP_USB_CONFIGURATION_H
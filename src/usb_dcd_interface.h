@@ -14,11 +14,10 @@
 #ifndef TUPP_USB_DCD_INTERFACE_H
 #define TUPP_USB_DCD_INTERFACE_H
 
-#include <functional>
-using std::function;
 
 #include "usb_structs.h"
 #include "usb_config.h"
+#include "usb_delegate.h"
 
 class usb_endpoint;
 class usb_interface;
@@ -39,10 +38,26 @@ public:
     virtual void reset_address() = 0;
 
     // Set handler for setup packets
-    function<void(TUPP::setup_packet_t * packet)> setup_handler;
+    delegate<void(TUPP::setup_packet_t * packet)> setup_handler;
 
     // Set handler for bus reset
-    function<void()> bus_reset_handler;
+    delegate<void()> bus_reset_handler;
+
+    // Frame number (11 bit) of the last SOF (start of frame)
+    virtual uint16_t frame_number() = 0;
+
+    // Enable/Disable the SOF interrupt. If enabled, sof_handler
+    // is called in the IRQ context (or by process_events() in
+    // deferred event mode, see TUPP_DEFERRED_EVENTS) at the start
+    // of every frame (every millisecond) with the new frame number.
+    virtual void sof_enable(bool e) = 0;
+
+    // Set handler for SOF
+    delegate<void(uint16_t frame)> sof_handler;
+
+    // Microseconds since the last SOF, e.g. to timestamp data.
+    // Only valid while the SOF interrupt is enabled.
+    virtual uint32_t us_since_sof() = 0;
 
     // Create a new endpoint based on its address.
     virtual usb_endpoint * create_endpoint(
@@ -63,6 +78,14 @@ public:
 
     virtual usb_endpoint * addr_to_ep(uint8_t addr) = 0;
 
+    // Call func on the core which handles the USB interrupt
+    // (the core which has enabled it). In dual-core mode (see
+    // TUPP_DUAL_CORE), a call from the other core is queued and
+    // executed in the USB interrupt. Only one context of the
+    // other core may use this method. Otherwise func is called
+    // directly. Return false if the queue is full.
+    virtual bool call_on_usb_core(delegate<void()> func) = 0;
+
 protected:
     virtual ~usb_dcd_interface() = default;
 };
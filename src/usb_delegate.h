@@ -0,0 +1,113 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// A non-allocating replacement for std::function, which
+// is used for the callbacks called in the USB IRQ context.
+//
+// The callable object (a lambda, a function pointer, or an
+// object pointer with a member function, see bind()) is stored
+// in a fixed buffer inside the delegate, together with a pointer
+// to a function which invokes it. Only callables which fit into
+// this buffer (TUPP_DELEGATE_SIZE) and which are trivially
+// copyable and destructible are accepted, e.g. lambdas which
+// capture pointers or references. This is checked at compile
+// time, so a delegate never uses the heap, and copying it is
+// a plain memory copy. A call is a single indirect call.
+//
+#ifndef TUPP_USB_DELEGATE_H
+#define TUPP_USB_DELEGATE_H
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "usb_config.h"
+
+template<typename T>
+class delegate;
+
+template<typename R, typename... Args>
+class delegate<R(Args...)> {
+
+    // Check if F can be stored in a delegate
+    template<typename F>
+    static constexpr bool is_callable =
+        !std::is_same_v<std::decay_t<F>, delegate> &&
+        std::is_invocable_r_v<R, std::decay_t<F> &, Args...>;
+
+public:
+    delegate() = default;
+    delegate(std::nullptr_t) {}
+
+    template<typename F, typename = std::enable_if_t<is_callable<F>>>
+    delegate(F && f) {
+        assign(std::forward<F>(f));
+    }
+
+    template<typename F, typename = std::enable_if_t<is_callable<F>>>
+    delegate & operator= (F && f) {
+        assign(std::forward<F>(f));
+        return *this;
+    }
+
+    delegate & operator= (std::nullptr_t) {
+        _invoke = nullptr;
+        return *this;
+    }
+
+    // Create a delegate calling METHOD on the object obj, e.g.
+    // delegate<void()>::bind<&my_class::handler>(this)
+    template<auto METHOD, typename C>
+    static delegate bind(C * obj) {
+        return delegate([obj](Args... args) -> R {
+            return (obj->*METHOD)(std::forward<Args>(args)...);
+        });
+    }
+
+    explicit operator bool() const {
+        return _invoke != nullptr;
+    }
+
+    R operator() (Args... args) const {
+        assert(_invoke);
+        return _invoke(_storage, std::forward<Args>(args)...);
+    }
+
+private:
+    template<typename F>
+    void assign(F && f) {
+        using T = std::decay_t<F>;
+        static_assert(sizeof(T) <= TUPP_DELEGATE_SIZE,
+                      "Callable is too large for a delegate (see TUPP_DELEGATE_SIZE)");
+        static_assert(alignof(T) <= alignof(void *),
+                      "Callable has an unsupported alignment");
+        static_assert(std::is_trivially_copyable_v<T> &&
+                      std::is_trivially_destructible_v<T>,
+                      "Callable has to be trivially copyable (only capture pointers or references)");
+        ::new (_storage) T(std::forward<F>(f));
+        _invoke = [](void * obj, Args... args) -> R {
+            if constexpr (std::is_void_v<R>) {
+                (*static_cast<T *>(obj))(std::forward<Args>(args)...);
+            } else {
+                return (*static_cast<T *>(obj))(std::forward<Args>(args)...);
+            }
+        };
+    }
+
+    alignas(void *) mutable unsigned char _storage[TUPP_DELEGATE_SIZE] {};
+    R (*_invoke)(void *, Args...) {nullptr};
+};
+
+#endif // TUPP_USB_DELEGATE_H
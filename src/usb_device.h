@@ -18,8 +18,8 @@ class usb_configuration;
 class usb_bos;
 #include "usb_structs.h"
 #include "usb_config.h"
+#include "usb_delegate.h"
 #include <array>
-#include <functional>
 
 class usb_device {
 public:
@@ -80,7 +80,7 @@ public:
     // The setup message handler which handles all
     // non-standard commands directed to this device.
     // Will be called by the usb_device_controller.
-    std::function<void(TUPP::setup_packet_t * packet)> setup_handler;
+    delegate<void(TUPP::setup_packet_t * packet)> setup_handler;
 
 private:
     // The device descriptor
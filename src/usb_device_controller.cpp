@@ -18,6 +18,7 @@
 // destination.
 #include <cstring>
 #include <cassert>
+#include <iterator>
 
 #include "usb_device_controller.h"
 #include "usb_structs.h"
@@ -38,8 +39,15 @@ using enum TUPP::ep_attributes_t;
 using enum TUPP::direction_t;
 using enum usb_log::log_level;
 
+#if TUPP_STATIC_DESCRIPTORS
+usb_device_controller::usb_device_controller(usb_dcd_interface & driver, usb_device & device,
+                                             const STATIC::descriptor_set & descriptors)
+    : active_configuration(_active_configuration), _driver(driver), _device(device),
+      _descriptors(descriptors)
+#else
 usb_device_controller::usb_device_controller(usb_dcd_interface & driver, usb_device & device)
     : active_configuration(_active_configuration), _driver(driver), _device(device)
+#endif
 {
     TUPP_LOG(LOG_DEBUG, "usb_device_controller() @%x", this);
     // Create standard endpoints with address 0
@@ -51,6 +59,11 @@ usb_device_controller::usb_device_controller(usb_dcd_interface & driver, usb_dev
         if (len) _ep0_out->send_zlp_data1();
     };
     _ep0_out->data_handler = [&](uint8_t * data, uint16_t len) {
+        // Streamed data stage
+        if (_stream_left) {
+            handle_stream_chunk(data, len);
+            return;
+        }
         // Reply to received data with zero-length packet
         if (len) _ep0_in->send_zlp_data1();
         // Call data handler. Remember we are in an IRQ context here,
@@ -68,101 +81,67 @@ usb_device_controller::usb_device_controller(usb_dcd_interface & driver, usb_dev
         // Reset the USB address
         _driver.reset_address();
         // Deactivate configuration, if existing
-        if (_active_configuration) {
-            auto conf = _device.find_configuration(_active_configuration);
-            if (conf) {
-                conf->activate_endpoints(false);
-            } else{
-                TUPP_LOG(LOG_WARNING, "Could not deactivate configuration %d",
-                         _active_configuration);
-            }
+        if (_config) {
+            _config->activate_endpoints(false);
         }
+        set_routing(nullptr);
         _active_configuration = 0;
+        _stream_left = 0;
     };
 
     // Handler for setup requests
     _driver.setup_handler = [&](TUPP::setup_packet_t *pkt) {
         TUPP_LOG(LOG_DEBUG, "setup_handler()");
-        // Reset EP0
+        // Reset EP0 and abort a streamed data stage
         _ep0_in->reset();
         _ep0_out->reset();
+        _stream_left = 0;
         // Process standard requests
         if (pkt->type == type_t::TYPE_STANDARD) {
-            switch (pkt->bRequest) {
-                // Device requests
-                case REQ_SET_ADDRESS:
-                    handle_set_address(pkt);
-                    break;
-                case REQ_GET_DESCRIPTOR:
-                    handle_get_descriptor(pkt);
-                    break;
-                case REQ_SET_DESCRIPTOR:
-                    handle_set_descriptor(pkt);
-                    break;
-                case REQ_GET_CONFIGURATION:
-                    handle_get_configuration(pkt);
-                    break;
-                case REQ_SET_CONFIGURATION:
-                    handle_set_configuration(pkt);
-                    break;
-                // Interface requests
-                case REQ_GET_INTERFACE:
-                    handle_get_interface(pkt);
-                    break;
-                case REQ_SET_INTERFACE:
-                    handle_set_interface(pkt);
-                    break;
-                    // Endpoint requests
-                case REQ_SYNCH_FRAME:
-                    handle_synch_frame(pkt);
-                    break;
-                // Requests for different recipients
-                case REQ_GET_STATUS:
-                    handle_get_status(pkt);
-                    break;
-                case REQ_CLEAR_FEATURE:
-                    handle_clear_feature(pkt);
-                    break;
-                case REQ_SET_FEATURE:
-                    handle_set_feature(pkt);
-                    break;
-                default:
-                    TUPP_LOG(LOG_WARNING, "Unknown standard setup request type %d", pkt->type);
+            auto req = (uint8_t)pkt->bRequest;
+            request_handler_t method = nullptr;
+            if (req < std::size(_standard_requests)) {
+                method = _standard_requests[req];
+            }
+            if (method) {
+                (this->*method)(pkt);
+            } else {
+                TUPP_LOG(LOG_WARNING, "Unknown standard setup request %d", req);
             }
         } else {
             // We received a non-standard request.
             // Find the proper destination and forward it.
+            delegate<void(TUPP::setup_packet_t *)> * dest = nullptr;
             switch(pkt->recipient) {
                 case REC_DEVICE: {
-                    if (_device.setup_handler) {
-                        _device.setup_handler(pkt);
-                    }
+                    dest = &_device.setup_handler;
                     break;
                 }
                 case REC_INTERFACE: {
-                    auto config = _device.find_configuration(_active_configuration);
-                    if (config) {
-                        auto interface = config->interfaces[pkt->wIndex];
-                        if (interface) {
-                            if (interface->setup_handler) {
-                                interface->setup_handler(pkt);
-                            }
-                        }
+                    uint8_t index = pkt->wIndex & 0xff;
+                    if (index < TUPP_MAX_INTERF_PER_CONF && _interfaces[index]) {
+                        dest = &_interfaces[index]->setup_handler;
                     }
                     break;
                 }
                 case REC_ENDPOINT: {
-                    auto ep = _driver.addr_to_ep(pkt->wIndex);
-                    if (ep) {
-                        if (ep->setup_handler) {
-                            ep->setup_handler(pkt);
-                        }
-                    }
+                    // Endpoints outside of the active configuration
+                    // (or before SET_CONFIGURATION) are looked up
+                    // in the driver
+                    uint8_t addr = pkt->wIndex & 0xff;
+                    usb_endpoint * ep = _endpoints[ep_slot(addr)];
+                    if (!ep) ep = _driver.addr_to_ep(addr);
+                    if (ep) dest = &ep->setup_handler;
                     break;
                 }
-                default: {
-                    TUPP_LOG(LOG_WARNING, "Could not find recipient %d", pkt->recipient);
-                }
+                default:
+                    break;
+            }
+            if (dest && *dest) {
+                (*dest)(pkt);
+            } else {
+                TUPP_LOG(LOG_WARNING, "Could not find recipient %d (index %d)",
+                         pkt->recipient, pkt->wIndex);
             }
         }
     };
@@ -171,6 +150,77 @@ usb_device_controller::usb_device_controller(usb_dcd_interface & driver, usb_dev
     _driver.irq_enable(true);
 }
 
+const usb_device_controller::request_handler_t
+usb_device_controller::_standard_requests[13] = {
+    &usb_device_controller::handle_get_status,          // REQ_GET_STATUS
+    &usb_device_controller::handle_clear_feature,       // REQ_CLEAR_FEATURE
+    nullptr,
+    &usb_device_controller::handle_set_feature,         // REQ_SET_FEATURE
+    nullptr,
+    &usb_device_controller::handle_set_address,         // REQ_SET_ADDRESS
+    &usb_device_controller::handle_get_descriptor,      // REQ_GET_DESCRIPTOR
+    &usb_device_controller::handle_set_descriptor,      // REQ_SET_DESCRIPTOR
+    &usb_device_controller::handle_get_configuration,   // REQ_GET_CONFIGURATION
+    &usb_device_controller::handle_set_configuration,   // REQ_SET_CONFIGURATION
+    &usb_device_controller::handle_get_interface,       // REQ_GET_INTERFACE
+    &usb_device_controller::handle_set_interface,       // REQ_SET_INTERFACE
+    &usb_device_controller::handle_synch_frame          // REQ_SYNCH_FRAME
+};
+
+void usb_device_controller::receive_control_data(setup_packet_t * pkt, uint8_t * buffer,
+                                                 uint16_t size, stream_handler_t func) {
+    TUPP_LOG(LOG_DEBUG, "receive_control_data(%d)", pkt->wLength);
+    assert(pkt->direction == DIR_OUT);
+    assert(size && !(size % _ep0_out->descriptor.wMaxPacketSize));
+    if (!pkt->wLength) {
+        // No data stage, so only send the status stage
+        _ep0_in->send_zlp_data1();
+        return;
+    }
+    _stream_handler = func;
+    _stream_buf     = buffer;
+    _stream_size    = size;
+    _stream_offset  = 0;
+    _stream_left    = pkt->wLength;
+    _stream_chunk   = _stream_left < size ? _stream_left : size;
+    _ep0_out->start_transfer(_stream_buf, _stream_chunk);
+}
+
+void usb_device_controller::handle_stream_chunk(uint8_t * data, uint16_t len) {
+    bool ok = _stream_handler(data, len, _stream_offset);
+    _stream_offset += len;
+    _stream_left   -= len;
+    if (!ok) {
+        // The data could not be processed
+        TUPP_LOG(LOG_WARNING, "Control data rejected at offset %d", _stream_offset);
+        _stream_left = 0;
+        _ep0_in->send_stall(true);
+        _ep0_out->send_stall(true);
+    } else if (_stream_left && len == _stream_chunk) {
+        // Receive the next chunk
+        _stream_chunk = _stream_left < _stream_size ? _stream_left : _stream_size;
+        _ep0_out->start_transfer(_stream_buf, _stream_chunk);
+    } else {
+        // All data received (or short packet), so send the status stage
+        _stream_left = 0;
+        _ep0_in->send_zlp_data1();
+    }
+}
+
+void usb_device_controller::set_routing(usb_configuration * conf) {
+    _config = conf;
+    for (auto & uif : _interfaces) uif = nullptr;
+    for (auto & ep  : _endpoints)  ep  = nullptr;
+    if (!conf) return;
+    for (usb_interface * uif : conf->interfaces) {
+        if (!uif) continue;
+        _interfaces[uif->descriptor.bInterfaceNumber] = uif;
+        for (usb_endpoint * ep : uif->_endpoints) {
+            if (ep) _endpoints[ep_slot(ep->descriptor.bEndpointAddress)] = ep;
+        }
+    }
+}
+
 void usb_device_controller::handle_set_address(setup_packet_t * pkt) {
     TUPP_LOG(LOG_DEBUG, "handle_set_address()");
     assert(pkt->direction == DIR_OUT);
@@ -189,57 +239,52 @@ void usb_device_controller::handle_get_descriptor(setup_packet_t * pkt) {
     // Extract type and index
     uint8_t desc_index = pkt->wValue & 0xff;
     auto desc_type = (TUPP::bDescriptorType_t)(pkt->wValue >> 8);
-    // Initialize data pointer
-    uint8_t * tmp_ptr = _buf;
     switch (desc_type) {
         case DESC_DEVICE: {
             TUPP_LOG(LOG_INFO, "Get device descriptor (len=%d)",
                      pkt->wLength);
             // Sometimes the host wants to get only a fraction of
-            // the descriptor (on a MACbook len=8).
-            // So no strict check with assert(_device.descriptor.bLength <= pkt->wLength);
-            uint16_t len = _device.descriptor.bLength;
-            if (pkt->wLength < len) len = pkt->wLength;
-            _ep0_in->start_transfer((uint8_t *) &_device.descriptor, len);
+            // the descriptor (on a MACbook len=8), so send_descriptor()
+            // does not check the requested length strictly.
+#if TUPP_STATIC_DESCRIPTORS
+            const uint8_t * desc = _descriptors.device();
+#else
+            auto desc = (const uint8_t *) &_device.descriptor;
+#endif
+            send_descriptor(pkt, desc, desc[0]);
             break;
         }
         case DESC_CONFIGURATION: {
             TUPP_LOG(LOG_INFO, "Get configuration descriptor (index %d, len=%d)",
                      desc_index, pkt->wLength);
             auto conf = _device.configurations[desc_index];
-            if (conf) {
-                assert(pkt->wLength >= sizeof(configuration_descriptor_t));
-                // Copy configuration descriptor first
-                memcpy(tmp_ptr, &conf->descriptor, sizeof(configuration_descriptor_t));
-                tmp_ptr += sizeof(configuration_descriptor_t);
-                // Check if we need the big stuff
-                if (pkt->wLength >= conf->descriptor.wTotalLength) {
-                    // Copy interface and endpoint descriptors
-                    for (auto interface : conf->interfaces) {
-                        if (interface) {
-                            tmp_ptr += interface->prepare_descriptor(
-                                tmp_ptr, TUPP_MAX_DESC_SIZE - (tmp_ptr-_buf));
-                        }
-                    }
-                }
-                uint16_t len = tmp_ptr - _buf;
-            assert(len <= pkt->wLength);
-            _ep0_in->start_transfer(_buf, len);
-            } else {
-                // No configuration, stall the EP0
-                _ep0_in->send_stall(true);
-                _ep0_out->send_stall(true);
-            }
+#if TUPP_STATIC_DESCRIPTORS
+            const uint8_t * desc = _descriptors.configuration(desc_index);
+            uint16_t len = desc ? STATIC::descriptor_set::length(desc) : 0;
+            // The constant descriptor has to match the configuration
+            // byte by byte (only checked in debug builds)
+            assert(!desc || (conf && conf->matches_descriptor(desc, len)));
+#else
+            // The serialized descriptor tree
+            std::span<const uint8_t> blob;
+            if (conf) blob = conf->get_descriptor_blob();
+            const uint8_t * desc = blob.data();
+            uint16_t len = blob.size();
+#endif
+            send_descriptor(pkt, desc, len);
             break;
         }
         case DESC_STRING: {
             TUPP_LOG(LOG_INFO, "Get string descriptor [%d] (len=%d)",
                      pkt->wValue & 0xff, pkt->wLength);
             uint8_t index = pkt->wValue & 0xff;
+#if TUPP_STATIC_DESCRIPTORS
+            const uint8_t * desc = _descriptors.string(index);
+            send_descriptor(pkt, desc, desc ? desc[0] : 0);
+#else
             uint8_t len = usb_strings::inst.prepare_string_desc_utf16(index, _buf);
-            if (len > pkt->wLength) len = pkt->wLength;
-            assert(len <= pkt->wLength);
-            _ep0_in->start_transfer(_buf, len);
+            send_descriptor(pkt, _buf, len);
+#endif
             break;
         }
         case DESC_OTG: {
@@ -256,18 +301,19 @@ void usb_device_controller::handle_get_descriptor(setup_packet_t * pkt) {
         }
         case DESC_BOS: {
             TUPP_LOG(LOG_INFO, "Get BOS descriptor (len=%d)", pkt->wLength);
+#if TUPP_STATIC_DESCRIPTORS
+            const uint8_t * desc = _descriptors.bos();
+            send_descriptor(pkt, desc, desc ? STATIC::descriptor_set::length(desc) : 0);
+#else
             if (_device.bos) {
                 // We have a BOS descriptor
-                tmp_ptr += _device.bos->prepare_descriptor(
-                           tmp_ptr, TUPP_MAX_DESC_SIZE - (tmp_ptr-_buf));
-                uint16_t len = tmp_ptr - _buf;
-                if (pkt->wLength < len) len = pkt->wLength;
-                _ep0_in->start_transfer(_buf, len);
+                uint16_t len = _device.bos->prepare_descriptor(_buf, TUPP_MAX_DESC_SIZE);
+                send_descriptor(pkt, _buf, len);
             } else {
                 // No BOS, so stall the EP0
-                _ep0_in->send_stall(true);
-                _ep0_out->send_stall(true);
+                send_descriptor(pkt, nullptr, 0);
             }
+#endif
             break;
         }
         case DESC_DEVICE_QUALIFIER: {
@@ -285,6 +331,18 @@ void usb_device_controller::handle_get_descriptor(setup_packet_t * pkt) {
     }
 }
 
+void usb_device_controller::send_descriptor(setup_packet_t * pkt,
+                                            const uint8_t * desc, uint16_t len) {
+    if (desc) {
+        if (len > pkt->wLength) len = pkt->wLength;
+        _ep0_in->start_transfer((uint8_t *)desc, len, len < pkt->wLength);
+    } else {
+        // Descriptor not available, stall the EP0
+        _ep0_in->send_stall(true);
+        _ep0_out->send_stall(true);
+    }
+}
+
 void usb_device_controller::handle_set_descriptor(setup_packet_t * pkt) {
     TUPP_LOG(LOG_INFO, "Set descriptor");
     (void)pkt;
@@ -309,23 +367,21 @@ void usb_device_controller::handle_set_configuration(setup_packet_t *pkt) {
     assert(pkt->recipient == REC_DEVICE);
     uint8_t index = pkt->wValue & 0xff;
     // Check if we change the configuration
-    usb_configuration * conf = nullptr;
     if (_active_configuration != index) {
         // De-activate current configuration
-        if (_active_configuration) {
-            conf = _device.find_configuration(_active_configuration);
-            if (conf) {
-                conf->activate_endpoints(false);
-                TUPP_LOG(LOG_INFO, "Disabled configuration %d", _active_configuration);
-            }
-            _active_configuration = 0;
+        if (_config) {
+            _config->activate_endpoints(false);
+            TUPP_LOG(LOG_INFO, "Disabled configuration %d", _active_configuration);
         }
+        set_routing(nullptr);
+        _active_configuration = 0;
         if (index) {
-            conf = _device.find_configuration(index);
+            auto conf = _device.find_configuration(index);
             if (conf) {
                 conf->activate_endpoints(true);
                 TUPP_LOG(LOG_INFO, "Enabled configuration %d", index);
             }
+            set_routing(conf);
             _active_configuration = index;
         }
     }
@@ -338,12 +394,9 @@ void usb_device_controller::handle_get_interface(setup_packet_t *pkt) {
     assert(pkt->direction == DIR_IN);
     assert(pkt->recipient == REC_INTERFACE);
     uint8_t index = pkt->wIndex & 0xff;
-    if (_active_configuration) {
-        auto interface = _device.configurations[_active_configuration]->interfaces[index];
-        if (interface) {
-            _ep0_in->start_transfer(&interface->_descriptor.bAlternateSetting, 1);
-            return;
-        }
+    if (index < TUPP_MAX_INTERF_PER_CONF && _interfaces[index]) {
+        _ep0_in->start_transfer(&_interfaces[index]->_descriptor.bAlternateSetting, 1);
+        return;
     }
     // We did not find the interface, so stall EP0
     _ep0_in->send_stall(true);
@@ -355,11 +408,8 @@ void usb_device_controller::handle_set_interface(setup_packet_t *pkt) {
     assert(pkt->direction == DIR_OUT);
     assert(pkt->recipient == REC_INTERFACE);
     uint8_t index = pkt->wIndex & 0xff;
-    if (_active_configuration) {
-        auto interface = _device.configurations[_active_configuration]->interfaces[index];
-        if (interface) {
-            interface->set_bAlternateSetting(pkt->wValue & 0xff);
-        }
+    if (index < TUPP_MAX_INTERF_PER_CONF && _interfaces[index]) {
+        _interfaces[index]->set_bAlternateSetting(pkt->wValue & 0xff);
     }
     // Status stage
     _ep0_in->send_zlp_data1();
@@ -372,10 +422,17 @@ void usb_device_controller::handle_synch_frame(setup_packet_t *pkt) {
     uint8_t addr = pkt->wIndex & 0xff;
     // Find endpoint and forward request
     auto ep = _driver.addr_to_ep(addr);
-    if (ep) {
-        if (ep->setup_handler) {
-            ep->setup_handler(pkt);
-        }
+    if (ep && ep->setup_handler) {
+        ep->setup_handler(pkt);
+    } else if (ep && ep->is_iso()) {
+        // Without a handler of the class, report
+        // the current frame number
+        uint16_t frame = _driver.frame_number();
+        _ep0_in->start_transfer((uint8_t *)&frame, 2);
+    } else {
+        // Only supported for ISO endpoints
+        _ep0_in->send_stall(true);
+        _ep0_out->send_stall(true);
     }
 }
 
@@ -387,12 +444,11 @@ void usb_device_controller::handle_get_status(setup_packet_t * pkt) {
     uint16_t data = 0;
     switch(pkt->recipient) {
         case REC_DEVICE: {
-            auto config = _device.find_configuration(_active_configuration);
-            if (config) {
-                if (config->descriptor.bmAttributes.self_powered) {
+            if (_config) {
+                if (_config->descriptor.bmAttributes.self_powered) {
                     data |= 1;
                 }
-                if (config->descriptor.bmAttributes.remote_wakeup) {
+                if (_config->descriptor.bmAttributes.remote_wakeup) {
                     data |= 2;
                 }
             } else {
@@ -428,8 +484,7 @@ void usb_device_controller::handle_clear_feature(setup_packet_t *pkt) {
         case REC_DEVICE: {
             if (pkt->wValue == 1) {
                 TUPP_LOG(LOG_INFO, "Set feature: Remote wakeup off");
-                auto config = _device.find_configuration(_active_configuration);
-                if (config) config->set_remote_wakeup(false);
+                if (_config) _config->set_remote_wakeup(false);
             } else {
                 TUPP_LOG(LOG_WARNING, "Unknown CLEAR FEATURE id: %d", pkt->wValue);
             }
@@ -459,8 +514,7 @@ void usb_device_controller::handle_set_feature(setup_packet_t *pkt) {
         case REC_DEVICE: {
             if (pkt->wValue == 1) {
                 TUPP_LOG(LOG_INFO, "Set feature: Remote wakeup on");
-                auto config = _device.find_configuration(_active_configuration);
-                if (config) config->set_remote_wakeup(true);
+                if (_config) _config->set_remote_wakeup(true);
             } else {
                 TUPP_LOG(LOG_WARNING, "Unknown SET FEATURE id: %d", pkt->wValue);
             }
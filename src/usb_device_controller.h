@@ -15,14 +15,26 @@
 #define TUPP_USB_DEVICE_CONTROLLER_H
 
 class usb_device;
+class usb_configuration;
+class usb_interface;
 #include "usb_config.h"
 #include "usb_dcd_interface.h"
 #include "usb_endpoint.h"
-#include <functional>
+#include "usb_delegate.h"
+#if TUPP_STATIC_DESCRIPTORS
+#include "usb_static_descriptors.h"
+#endif
 
 class usb_device_controller {
 public:
+#if TUPP_STATIC_DESCRIPTORS
+    // The descriptors are sent from the constant
+    // descriptor set (see usb_static_descriptors.h)
+    usb_device_controller(usb_dcd_interface & driver, usb_device & device,
+                          const TUPP::STATIC::descriptor_set & descriptors);
+#else
     usb_device_controller(usb_dcd_interface & driver, usb_device & device);
+#endif
 
     // Create a new endpoint based on its address.
     usb_endpoint * create_endpoint(
@@ -44,13 +56,40 @@ public:
         return _driver.create_endpoint(direction, type, packet_size, interval, &interface);
     }
 
+    // Call func on the core which handles the USB interrupt
+    // (see usb_dcd_interface::call_on_usb_core())
+    inline bool call_on_usb_core(delegate<void()> func) {
+        return _driver.call_on_usb_core(func);
+    }
+
+    // Callback for the data stage of a control OUT request. It is
+    // called with each received chunk and the chunk offset in the
+    // data stage. Returning false stalls the status stage (e.g.
+    // if the data could not be stored).
+    using stream_handler_t =
+        delegate<bool(const uint8_t * data, uint16_t len, uint16_t offset)>;
+
+    // Receive the data stage of a control OUT request with up to
+    // 64 KB (pkt->wLength) chunk by chunk. This is called by a setup
+    // handler. Every chunk is received in buffer (size bytes, a
+    // multiple of the EP0 packet size) and passed to func in the
+    // IRQ context, so the next chunk is received after func has
+    // returned. The status stage is sent after the last chunk (or
+    // after a short packet of the host). A new SETUP packet aborts
+    // the transfer.
+    void receive_control_data(TUPP::setup_packet_t * pkt, uint8_t * buffer,
+                              uint16_t size, stream_handler_t func);
+
     const volatile uint8_t & active_configuration;
 
     // Standard endpoints 0
     usb_endpoint * _ep0_in  {nullptr};
     usb_endpoint * _ep0_out {nullptr};
 
-    std::function<void(uint8_t *, uint16_t)> handler;
+    // One-shot handler for a small control OUT data stage, which
+    // is received in one buffer with _ep0_out->start_transfer()
+    // (see receive_control_data() for larger data stages)
+    delegate<void(uint8_t *, uint16_t)> handler;
 
 private:
 
@@ -66,11 +105,56 @@ private:
     void handle_clear_feature    (TUPP::setup_packet_t * pkt);
     void handle_set_feature      (TUPP::setup_packet_t * pkt);
 
+    // Send a descriptor with len bytes (shortened to the
+    // requested length), or stall EP0 if desc is nullptr
+    void send_descriptor(TUPP::setup_packet_t * pkt, const uint8_t * desc, uint16_t len);
+
+    // Handlers of the standard requests, indexed by bRequest
+    using request_handler_t = void (usb_device_controller::*)(TUPP::setup_packet_t *);
+    static const request_handler_t _standard_requests[13];
+
+    // Pass a received chunk of a control OUT data stage to
+    // the stream handler, and receive the next chunk or send
+    // the status stage
+    void handle_stream_chunk(uint8_t * data, uint16_t len);
+
+    // Set the active configuration (or nullptr) and populate
+    // the routing tables with its interfaces and endpoints
+    void set_routing(usb_configuration * conf);
+
+    // Slot of an endpoint in _endpoints (IN endpoints on the even slots)
+    static constexpr uint8_t ep_slot(uint16_t addr) {
+        return ((addr & 0x0f) << 1) | !(addr & 0x80);
+    }
+
     usb_dcd_interface & _driver;
     usb_device &        _device;
     volatile uint8_t    _active_configuration {0};
+
+    // Routing tables for the requests: The active configuration,
+    // its interfaces (indexed by bInterfaceNumber) and endpoints
+    // (indexed by ep_slot()). They are populated when a
+    // configuration is activated, so no search is needed.
+    usb_configuration * _config {nullptr};
+    usb_interface *     _interfaces[TUPP_MAX_INTERF_PER_CONF] {};
+    usb_endpoint *      _endpoints[32] {};
+
+    // State of a streamed control OUT data stage: The handler, the
+    // chunk buffer, the offset and size of the current chunk and
+    // the remaining bytes (0 if no data stage is streamed)
+    stream_handler_t    _stream_handler;
+    uint8_t *           _stream_buf    {nullptr};
+    uint16_t            _stream_size   {0};
+    uint16_t            _stream_offset {0};
+    uint16_t            _stream_chunk  {0};
+    uint16_t            _stream_left   {0};
+#if TUPP_STATIC_DESCRIPTORS
+    // The constant descriptors
+    const TUPP::STATIC::descriptor_set & _descriptors;
+#else
     // Buffer for device descriptors
     uint8_t             _buf[TUPP_MAX_DESC_SIZE] {};
+#endif
 };
 
 #endif  // TUPP_USB_DEVICE_CONTROLLER_H
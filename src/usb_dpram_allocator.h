@@ -0,0 +1,100 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Allocator for the endpoint buffers in the USB RAM (DPRAM)
+// of a device controller. The memory is managed in blocks of
+// GRANULE bytes (the alignment needed by the HW), which are
+// marked in a bitmap. A buffer is allocated with a first-fit
+// strategy and can be released again, e.g. when the packet
+// size of an endpoint changes with an alternate setting.
+// The usage and the largest free block (fragmentation) can
+// be checked at runtime.
+//
+#ifndef TUPP_USB_DPRAM_ALLOCATOR_H
+#define TUPP_USB_DPRAM_ALLOCATOR_H
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+template<size_t SIZE, size_t GRANULE = 64>
+class usb_dpram_allocator {
+public:
+    static constexpr size_t BLOCKS = SIZE / GRANULE;
+    static_assert(SIZE % GRANULE == 0, "Size has to be a multiple of the granule");
+    static_assert(BLOCKS <= 64, "At most 64 blocks are supported");
+
+    explicit usb_dpram_allocator(uint8_t * base) : _base(base) { }
+
+    // No copy, no assignment
+    usb_dpram_allocator(const usb_dpram_allocator &) = delete;
+    usb_dpram_allocator & operator= (const usb_dpram_allocator &) = delete;
+
+    // Allocate a buffer of len bytes (rounded up to GRANULE).
+    // Return nullptr if there is no free block large enough.
+    uint8_t * allocate(size_t len) {
+        size_t n = blocks(len);
+        if (!n || n > BLOCKS) return nullptr;
+        uint64_t mask = (n == 64) ? ~0ull : ((1ull << n) - 1);
+        for (size_t i=0; i + n <= BLOCKS; ++i) {
+            if (!(_map & (mask << i))) {
+                _map |= mask << i;
+                if (used() > _high_water) _high_water = used();
+                return _base + i * GRANULE;
+            }
+        }
+        return nullptr;
+    }
+
+    // Release a buffer allocated with the same length
+    void release(uint8_t * ptr, size_t len) {
+        size_t n = blocks(len);
+        if (!ptr || !n) return;
+        size_t i = (ptr - _base) / GRANULE;
+        assert(ptr >= _base && i + n <= BLOCKS);
+        uint64_t mask = ((n == 64) ? ~0ull : ((1ull << n) - 1)) << i;
+        assert((_map & mask) == mask);
+        _map &= ~mask;
+    }
+
+    // Total size of the managed memory
+    inline size_t capacity() const { return SIZE; }
+
+    // Number of bytes in use
+    inline size_t used() const { return std::popcount(_map) * GRANULE; }
+
+    // Maximum number of bytes in use so far
+    inline size_t high_water() const { return _high_water; }
+
+    // Size of the largest buffer which can be allocated
+    size_t largest_free() const {
+        size_t best = 0, run = 0;
+        for (size_t i=0; i < BLOCKS; ++i) {
+            run = (_map & (1ull << i)) ? 0 : run + 1;
+            if (run > best) best = run;
+        }
+        return best * GRANULE;
+    }
+
+private:
+    static constexpr size_t blocks(size_t len) {
+        return (len + GRANULE - 1) / GRANULE;
+    }
+
+    uint8_t *   _base;
+    uint64_t    _map {0};
+    size_t      _high_water {0};
+};
+
+#endif // TUPP_USB_DPRAM_ALLOCATOR_H
@@ -14,27 +14,17 @@
 #include "usb_endpoint.h"
 #include "usb_interface.h"
 #include "usb_log.h"
+#include "usb_hw_copy.h"
 
 using enum usb_log::log_level;
 
-#if (TUPP_USE_BYTEWISE_MEMCPY)
-    // Use a simple version of memcpy to prevent unaligned accesses.
-    void tupp_memcpy (uint8_t *to, const uint8_t *from, size_t n) {
-        while (n--) *to++ = *from++;
-    }
-#else
-    // Use the standard memcpy
-    #include <cstring>
-    #define tupp_memcpy memcpy
-#endif
-
 usb_endpoint::usb_endpoint(
         uint8_t addr,
         TUPP::ep_attributes_t transfer_type,
         uint16_t packet_size,
         uint8_t interval,
         usb_interface *interface)
-: descriptor(_descriptor) {
+: descriptor(_descriptor), _interface(nullptr) {
     // Set descriptor length
     _descriptor.bLength = sizeof(TUPP::endpoint_descriptor_t);
     // Set descriptor type
@@ -44,41 +34,201 @@ usb_endpoint::usb_endpoint(
     set_bmAttributes    (transfer_type);
     set_wMaxPacketSize  (packet_size);
     set_bInterval       (interval);
+    // A full-speed ISO endpoint has an interval of 2^(n-1) frames
+    assert(!is_iso() || (interval >= 1 && interval <= 16));
     // Add this endpoint to its parent interface, if existing
+    _interface = interface;
     if (interface) interface->add_endpoint(this);
 }
 
+void usb_endpoint::update_descriptor() {
+    if (_interface) {
+        _interface->patch_descriptor(_blob_offset, &_descriptor, sizeof(_descriptor));
+    }
+}
+
 void usb_endpoint::reset() {
     TUPP_LOG(LOG_DEBUG, "reset()");
     send_stall(false);
     send_NAK(false);
     _active = false;
+    _pending = 0;
+    _queue.clear();
     _next_pid = 1;
 }
 
-void usb_endpoint::start_transfer(uint8_t * buffer, uint16_t len) {
+usb_endpoint::iso_stats_t usb_endpoint::iso_stats() const {
+    return { _iso_packets,
+             _iso_slots > _iso_packets ? _iso_slots - _iso_packets : 0 };
+}
+
+void usb_endpoint::reset_iso_stats() {
+    _iso_packets = 0;
+    _iso_slots   = 0;
+}
+
+void usb_endpoint::iso_frame(uint16_t frame) {
+    if (!_iso_slots) {
+        // First packet(s) of the stream
+        _iso_slots = _iso_packets + 1;
+    } else {
+        // Count the scheduled frames since the last call. All
+        // packets handled now have been transferred in them, so
+        // this also works if the IRQ handles two packets at once.
+        uint16_t elapsed = (frame - _iso_frame) & 0x7ff;
+        _iso_slots += elapsed >> (descriptor.bInterval - 1);
+    }
+    _iso_frame = frame;
+}
+
+void usb_endpoint::start_transfer(uint8_t * buffer, uint16_t len, bool send_zlp) {
+    segment_t segment { buffer, len };
+    start_transfer(std::span<const segment_t>(&segment, 1), send_zlp);
+}
+
+void usb_endpoint::start_transfer(std::span<const segment_t> segments, bool send_zlp) {
     assert(!_active) ;
+    assert(!segments.empty() && segments.size() <= TUPP_MAX_SEGMENTS);
+    // A released endpoint (packet size 0) can not transfer data
+    assert(_hw_buffer);
     // Mark this endpoint as active
     _active = true;
+    // Store the segments and calculate the total length
+    uint32_t len = 0;
+    for (size_t i=0; i < segments.size(); ++i) {
+        _segments[i] = segments[i];
+        len += segments[i].len;
+    }
+    assert(len <= 0xffff);
+    _in_place    = false;
+    _seg_count   = segments.size();
+    _seg_idx     = 0;
+    _current_ptr = segments[0].ptr;
+    _seg_left    = segments[0].len;
     // Store transfer parameters
-    _data_ptr    = buffer;
+    _data_ptr    = segments[0].ptr;
     _data_len    = len;
-    _current_ptr = buffer;
     _bytes_left  = len;
-    // Trigger the transfer (in or out).
-    // Limit size to max packet size.
-    _current_len = len > descriptor.wMaxPacketSize ?
-                   descriptor.wMaxPacketSize : len;
+    _arm_left    = len;
+    // A full last packet needs a ZLP to end the transfer
+    _zlp_left    = send_zlp && is_IN() && len &&
+                   !(len % descriptor.wMaxPacketSize);
+    // Trigger the transfer (in or out). For an empty
+    // transfer, a ZLP is sent/received. A second buffer
+    // is only armed in the IRQ context, so the IRQ can
+    // not interfere with our buffer handling here.
+    arm_packet();
+}
+
+void usb_endpoint::start_hw_transfer(uint16_t len) {
+    assert(!_active);
+    assert(len <= descriptor.wMaxPacketSize);
+    assert(_hw_buffer);
+    _active = true;
+    // No segments: The packet is sent from/received in
+    // HW buffer 0, which is used for a single packet.
+    _in_place   = true;
+    _seg_count  = 0;
+    _data_ptr   = _hw_buffer;
+    _data_len   = len;
+    _bytes_left = len;
+    _arm_left   = len;
+    _zlp_left   = false;
+    arm_packet();
+}
+
+void usb_endpoint::copy_segments(uint8_t * hw_buffer, uint16_t len) {
+    while (len) {
+        // Move on to the next segment
+        while (!_seg_left) {
+            assert(_seg_idx + 1 < _seg_count);
+            ++_seg_idx;
+            _current_ptr = _segments[_seg_idx].ptr;
+            _seg_left    = _segments[_seg_idx].len;
+        }
+        uint16_t n = len < _seg_left ? len : _seg_left;
+        if (is_IN()) {
+            tupp_copy_to_hw(hw_buffer, _current_ptr, n);
+        } else {
+            tupp_copy_from_hw(_current_ptr, hw_buffer, n);
+        }
+        hw_buffer    += n;
+        _current_ptr += n;
+        _seg_left    -= n;
+        len          -= n;
+    }
+}
+
+bool usb_endpoint::queue_transfer(uint8_t * buffer, uint16_t len, bool send_zlp) {
+    if (!_active) {
+        start_transfer(buffer, len, send_zlp);
+        return true;
+    }
+    if (!_queue.put({buffer, len, send_zlp})) {
+        return false;
+    }
+    // The active transfer might have been finished before
+    // the new entry was visible to the IRQ handler. In this
+    // case, the transfer has to be started here.
+    if (!_active) {
+        start_queued();
+    }
+    return true;
+}
+
+void usb_endpoint::start_queued() {
+    transfer_t next;
+    if (_queue.get(next)) {
+        start_transfer(next.buffer, next.len, next.send_zlp);
+    }
+}
+
+void usb_endpoint::finish_transfer(uint16_t len) {
+    uint8_t * buffer = _data_ptr;
+    _active = false;
+    // Start the next queued transfer before calling the
+    // user handler, so the HW can continue immediately.
+    start_queued();
+    if (data_handler) {
+        data_handler(buffer, len);
+    }
+}
 
-    if (is_IN() && _current_len) {
+void usb_endpoint::arm_packet() {
+    // Start with buffer 0 if no buffer is in use.
+    // The driver resets the HW buffer selector in
+    // this case (if double-buffered).
+    if (!_pending) {
+        _arm_buf  = 0;
+        _done_buf = 0;
+    }
+    uint8_t buf = _arm_buf;
+    // Limit size to max packet size.
+    uint16_t len = _arm_left > descriptor.wMaxPacketSize ?
+                   descriptor.wMaxPacketSize : _arm_left;
+    // Arming an empty packet after the data is the ZLP
+    if (!_arm_left) _zlp_left = false;
+    if (is_IN() && len && !_in_place) {
         // Copy the data from user buffer to the HW buffer
-        tupp_memcpy(_hw_buffer, _current_ptr, _current_len);
-        // Update transfer parameters
-        _bytes_left  -= _current_len;
-        _current_ptr += _current_len;
+        copy_segments(buf ? _hw_buffer_1 : _hw_buffer, len);
+    }
+    _arm_left -= len;
+    _armed_len[buf] = len;
+    _arm_buf ^= _double_buffered;
+    // ISO packets have no data toggle (always DATA0)
+    if (is_iso()) _next_pid = 0;
+    _pending++;
+    // Finally trigger the transfer in HW. This has to be
+    // the last step, because the packet might be processed
+    // (and the IRQ might be raised) immediately.
+    trigger_transfer(len, buf);
+}
+
+void usb_endpoint::arm_packets() {
+    uint8_t buffers = _double_buffered ? 2 : 1;
+    while ((_arm_left || _zlp_left) && (_pending < buffers)) {
+        arm_packet();
     }
-    // Trigger the transfer in HW.
-    trigger_transfer(_current_len);
 }
 
 void usb_endpoint::handle_buffer_in(uint16_t) {
@@ -88,29 +238,22 @@ void usb_endpoint::handle_buffer_in(uint16_t) {
     }
     // Entering this method means that the hw controller
     // has sent a packet of data to the host.
-    // Check if we need to change the hw address
-    // Check if the last packet has been sent
-    if (!_bytes_left) {
-        // Call user handler which will report the
-        // complete data which was sent to the host.
-        _active = false;
-        if (data_handler) {
-            data_handler(_data_ptr, _data_len);
-        }
+    if (is_iso()) _iso_packets++;
+    _bytes_left -= _armed_len[_done_buf];
+    _done_buf ^= _double_buffered;
+    _pending--;
+    // We need to send more data (or the final ZLP) to the
+    // host. So prepare consecutive packets in the free buffer(s).
+    if (_arm_left || _zlp_left) {
+        arm_packets();
         return;
     }
-    // We need to send more data to the host. So prepare
-    // a consecutive transfer. Limit the transfer size to
-    // the maximum packet size.
-    _current_len = _bytes_left > descriptor.wMaxPacketSize ?
-                   descriptor.wMaxPacketSize : _bytes_left;
-    // Copy the data from user buffer to the HW buffer
-    tupp_memcpy(_hw_buffer, _current_ptr, _current_len);
-    // Update transfer parameters
-    _bytes_left  -= _current_len;
-    _current_ptr += _current_len;
-    // Finally trigger the transfer
-    trigger_transfer(_current_len);
+    // Check if the last packet has been sent
+    if (!_pending) {
+        // Report the complete data which was
+        // sent to the host.
+        finish_transfer(_data_len);
+    }
 }
 
 void usb_endpoint::handle_buffer_out(uint16_t len) {
@@ -120,26 +263,31 @@ void usb_endpoint::handle_buffer_out(uint16_t len) {
     }
     // Entering this method means that the host has sent us a
     // new data packet. Copy all received bytes to the user buffer.
-    tupp_memcpy(_current_ptr, _hw_buffer, len);
+    if (!_in_place) {
+        copy_segments(_done_buf ? _hw_buffer_1 : _hw_buffer, len);
+    }
+    if (is_iso()) _iso_packets++;
     // Update transfer parameters
     _bytes_left  -= len;
-    _current_ptr += len;
+    uint16_t armed_len = _armed_len[_done_buf];
+    _done_buf ^= _double_buffered;
+    _pending--;
     // We terminate the transfer if we either have received
     // all bytes or received a 'short' packet, which returned
     // fewer bytes than expected.
-    if ((_bytes_left == 0) || (len < _current_len)) {
+    if ((_bytes_left == 0) || (len < armed_len)) {
+        if (_pending) {
+            // The second buffer is not needed any more. Take
+            // it back and undo its PID toggle.
+            cancel_buffer();
+            _next_pid ^= 1;
+            _pending--;
+        }
         // Let the user handler consume the complete
         // received data set.
-        _active = false;
-        if (data_handler) {
-            data_handler(_data_ptr, _data_len - _bytes_left);
-        }
+        finish_transfer(_data_len - _bytes_left);
         return;
     }
-    // More bytes to receive, so trigger a new transfer.
-    // Limit the transfer size to the maximum packet size.
-    _current_len = _bytes_left > descriptor.wMaxPacketSize ?
-                   descriptor.wMaxPacketSize : _bytes_left;
-    // Finally trigger the transfer
-    trigger_transfer(_current_len);
+    // More bytes to receive, so arm the free buffer(s)
+    arm_packets();
 }
@@ -20,15 +20,20 @@
 
 #include <cassert>
 #include <cstdint>
-#include <functional>
+#include <span>
 
 #include "usb_structs.h"
 #include "usb_config.h"
+#include "usb_fifo.h"
+#include "usb_delegate.h"
 
 class usb_interface;
 
 class usb_endpoint {
 public:
+    // Our friends
+    friend class usb_interface;     // serializes our descriptor
+
     // No copy, no assignment
     usb_endpoint(const usb_endpoint &) = delete;
     usb_endpoint & operator= (const usb_endpoint &) = delete;
@@ -36,15 +41,19 @@ public:
     // Methods to set the descriptor elements
     inline void set_bEndpointAddress(uint8_t n) {
         _descriptor.bEndpointAddress = n;
+        update_descriptor();
     }
     inline void set_bmAttributes(TUPP::ep_attributes_t n) {
         _descriptor.bmAttributes = n;
+        update_descriptor();
     }
     inline void set_wMaxPacketSize(uint16_t n) {
         _descriptor.wMaxPacketSize = n;
+        update_descriptor();
     }
     inline void set_bInterval(uint8_t n) {
         _descriptor.bInterval = n;
+        update_descriptor();
     }
 
     // Return true if this endpoint is an IN-endpoint
@@ -55,6 +64,14 @@ public:
     inline bool is_active() const {
         return _active;
     }
+    // Return true if this is an isochronous endpoint
+    inline bool is_iso() const {
+        return descriptor.bmAttributes == TUPP::ep_attributes_t::TRANS_ISOCHRONOUS;
+    }
+    // Return true if this endpoint uses two HW buffers
+    inline bool is_double_buffered() const {
+        return _double_buffered;
+    }
     // Send ZLP (Zero-Length Packet) with DATA1 pid
     inline void send_zlp_data1() {
         assert (_next_pid == 1);
@@ -66,19 +83,87 @@ public:
 
     // The data handler which is called when a transaction
     // to/from the host has finished.
-    std::function<void(uint8_t * buffer, uint16_t len)> data_handler;
+    delegate<void(uint8_t * buffer, uint16_t len)> data_handler;
 
     // The setup message handler which handles all
     // commands directed to this endpoint. Will be
     // called by the usb_device_controller.
-    std::function<void(TUPP::setup_packet_t * packet)> setup_handler;
+    delegate<void(TUPP::setup_packet_t * packet)> setup_handler;
 
     // Reset this endpoint to its default state
     // (no stall, no NAK, not active, next PID = 1)
     void reset();
 
     // Start a transfer on this endpoint (data stage).
-    void start_transfer(uint8_t * buffer, uint16_t len);
+    // An OUT transfer receives up to len bytes (which may
+    // be many packets). It ends when len bytes have been
+    // received, or with the first short packet (or ZLP)
+    // from the host. data_handler gets the received length.
+    // An IN transfer sends len bytes. If send_zlp is true
+    // and len is a non-zero multiple of wMaxPacketSize, a
+    // ZLP is sent at the end, so the host can detect the
+    // end of a transfer which is shorter than requested.
+    void start_transfer(uint8_t * buffer, uint16_t len, bool send_zlp = false);
+
+    // A memory segment of a scatter-gather transfer
+    struct segment_t {
+        uint8_t * ptr;
+        uint16_t  len;
+    };
+
+    // Start a transfer with up to TUPP_MAX_SEGMENTS segments,
+    // which are sent (IN) or filled (OUT) as one single USB
+    // transfer, so they do not have to be copied into one
+    // buffer first. data_handler is called with the pointer
+    // of the first segment and the total length.
+    void start_transfer(std::span<const segment_t> segments, bool send_zlp = false);
+
+    // Start a transfer, or append it to the transfer queue
+    // if the endpoint is active. Queued transfers are started
+    // in the IRQ context directly after the previous transfer
+    // has finished, and data_handler is called for each of them.
+    // The buffer has to stay valid until then. Return false if
+    // the queue is full. Do not call start_transfer() while
+    // transfers are queued.
+    bool queue_transfer(uint8_t * buffer, uint16_t len, bool send_zlp = false);
+
+    // Return the number of active and queued transfers
+    inline int pending_transfers() const {
+        return _active + _queue.available_get();
+    }
+
+    // Zero-copy access to the HW buffer of the next packet
+    // (wMaxPacketSize bytes). An IN packet is written directly
+    // into this buffer and sent with start_hw_transfer(len).
+    // Only valid while the endpoint is not active.
+    // Note: Some platforms (e.g. RP2350) only allow aligned
+    // accesses to the USB RAM (see usb_hw_copy.h).
+    inline std::span<uint8_t> hw_buffer() {
+        assert(!_active);
+        return { _hw_buffer, descriptor.wMaxPacketSize };
+    }
+
+    // Start a single-packet transfer (len <= wMaxPacketSize)
+    // without copying any data: An IN packet is sent from
+    // hw_buffer(), an OUT packet is received in hw_buffer().
+    // data_handler is called with the HW buffer, which is
+    // valid until the next transfer is started on this
+    // endpoint. So do not queue transfers behind an OUT
+    // transfer started with this method.
+    void start_hw_transfer(uint16_t len);
+
+    // Statistics of an isochronous endpoint. An ISO endpoint
+    // transfers one packet every 2^(bInterval-1) frames, without
+    // handshake and data toggle. A packet which is not armed in
+    // time is lost, and the frame is counted as missed. The
+    // counters assume a continuous stream of packets, so they
+    // should be reset when a stream is (re-)started.
+    struct iso_stats_t {
+        uint32_t packets;       // Transferred packets
+        uint32_t missed_frames; // Scheduled frames without a packet
+    };
+    iso_stats_t iso_stats() const;
+    void reset_iso_stats();
 
     // (De-)Activate this endpoint
     virtual void enable_endpoint(bool b) = 0;
@@ -94,6 +179,29 @@ public:
     // Get the STALLed status
     virtual bool is_stalled() const = 0;
 
+    // Enable/Disable double-buffering (ping-pong mode). Two
+    // HW buffers are used alternately, so the next packet of
+    // a transfer is already armed while the previous one is
+    // processed. Only bulk and isochronous endpoints (not EP0)
+    // support this mode, and it can only be changed while the
+    // endpoint is not active. Return true on success.
+    // Note: A second armed OUT buffer is taken back when a
+    // transfer ends with a short packet. If the host sends the
+    // next packet within this short time, it will be lost. So
+    // double-buffered OUT endpoints should be used with protocols
+    // where the host sends the expected length (e.g. MSC BOT).
+    virtual bool set_double_buffered(bool b) = 0;
+
+    // Change the max packet size of the endpoint (e.g. for an
+    // alternate setting with a different bandwidth). The HW
+    // buffers are released and re-allocated in the USB RAM.
+    // A size of 0 only releases the buffers (zero bandwidth),
+    // so no transfers are possible until a new size is set.
+    // Only possible while the endpoint is not active. Return
+    // false if there is not enough free USB RAM (the old size
+    // is kept in this case).
+    virtual bool set_packet_size(uint16_t packet_size) = 0;
+
 protected:
     // The endpoint CTOR is only accessible from the
     // derived implementations of this class
@@ -107,25 +215,99 @@ protected:
     void handle_buffer_in (uint16_t len);
     void handle_buffer_out(uint16_t len);
 
-    virtual void trigger_transfer(uint16_t len) = 0;
+    // Called by the driver of an ISO endpoint with the
+    // current frame number (from the last SOF), before
+    // the completed packets are handled.
+    void iso_frame(uint16_t frame);
+
+    // Arm the HW buffer buf (0 or 1) with a packet of len bytes.
+    // If it is the only armed buffer (_pending == 1), it is always
+    // buffer 0, and a double-buffered driver has to reset the HW
+    // buffer selector to buffer 0.
+    virtual void trigger_transfer(uint16_t len, uint8_t buf) = 0;
+
+    // Take back the armed (but unused) HW buffer _done_buf
+    virtual void cancel_buffer() = 0;
 
     // PID used for next transfer
     uint8_t         _next_pid {0};
     uint8_t *       _data_ptr {};
     uint16_t        _data_len {};
+    // The segments of the current transfer, and the position
+    // (and remaining bytes) in the current segment
+    segment_t       _segments[TUPP_MAX_SEGMENTS] {};
+    uint8_t         _seg_count {};
+    uint8_t         _seg_idx {};
     uint8_t *       _current_ptr {};
-    uint16_t        _current_len {};
+    uint16_t        _seg_left {};
+    // Bytes not yet transferred on the bus
     uint16_t        _bytes_left {};
+    // Bytes not yet armed in a HW buffer
+    uint16_t        _arm_left {};
+    // A ZLP still has to be armed after the data (IN only)
+    bool            _zlp_left {false};
+    // Data is already in (or stays in) the HW buffer
+    bool            _in_place {false};
 
     volatile bool   _active {false};
 
+    // The HW buffers. The second one is only used
+    // if the endpoint is double-buffered.
     uint8_t *       _hw_buffer {};
+    uint8_t *       _hw_buffer_1 {};
+    bool            _double_buffered {false};
+
+    // Buffer handling: The next buffer to be armed, the
+    // next buffer to be completed by the HW, the number of
+    // armed buffers and the length of the armed packets.
+    uint8_t         _arm_buf {0};
+    uint8_t         _done_buf {0};
+    uint8_t         _pending {0};
+    uint16_t        _armed_len[2] {};
+
+    // ISO statistics: Transferred packets, the number
+    // of scheduled frames, and the last frame number
+    uint32_t        _iso_packets {0};
+    uint32_t        _iso_slots {0};
+    uint16_t        _iso_frame {0};
 
     virtual ~usb_endpoint() = default;
 
 private:
-    // The endpoint descriptor
+    // Finish the current transfer and start the next
+    // queued one, before calling the data handler
+    void finish_transfer(uint16_t len);
+    // Start the next transfer from the queue (if any)
+    void start_queued();
+
+    // Transfers waiting for the active one to finish
+    struct transfer_t {
+        uint8_t * buffer;
+        uint16_t  len;
+        bool      send_zlp;
+    };
+    fifo<transfer_t, TUPP_EP_QUEUE_DEPTH> _queue;
+
+    // Copy len bytes between the segments and a HW buffer
+    // (direction depends on the endpoint direction)
+    void copy_segments(uint8_t * hw_buffer, uint16_t len);
+
+    // Arm the next packet of the current transfer
+    void arm_packet();
+    // Arm as many packets as there are free HW buffers
+    void arm_packets();
+
+    // Patch our descriptor in the serialized configuration
+    // descriptor of our parent interface (if any)
+    void update_descriptor();
+
+    // The parent interface (or nullptr for EP0)
+    usb_interface * _interface;
+
+    // The endpoint descriptor and its offset
+    // in the serialized configuration descriptor
     TUPP::endpoint_descriptor_t _descriptor {};
+    uint16_t _blob_offset {0};
 };
 
 #endif // TUPP_USB_ENDPOINT_H
@@ -0,0 +1,67 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Statically sized storage for the endpoint objects of a
+// driver. The endpoints are constructed in place by the
+// driver (placement new), so no heap is needed, and the RAM
+// usage is known at link time. Endpoints are never released,
+// so the number of used slots is also the high-water mark,
+// which can be used to adjust TUPP_MAX_ENDPOINTS.
+//
+#ifndef TUPP_USB_ENDPOINT_POOL_H
+#define TUPP_USB_ENDPOINT_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "usb_config.h"
+
+template<typename T, int N = TUPP_MAX_ENDPOINTS>
+class usb_endpoint_pool {
+public:
+    static_assert(N > 0 && N <= 32, "There are at most 16 IN and 16 OUT endpoints");
+
+    usb_endpoint_pool() = default;
+
+    // No copy, no assignment
+    usb_endpoint_pool(const usb_endpoint_pool &) = delete;
+    usb_endpoint_pool & operator= (const usb_endpoint_pool &) = delete;
+
+    // Return the storage for a new endpoint, which
+    // has to be constructed in place by the caller.
+    // Return nullptr if all slots are used.
+    void * allocate() {
+        assert(_used < N);
+        if (_used >= N) return nullptr;
+        return _slots[_used++].data;
+    }
+
+    // Maximum number of endpoints
+    inline int capacity() const { return N; }
+
+    // Number of endpoints created so far
+    inline int high_water() const { return _used; }
+
+    // Size of the complete pool in bytes
+    inline size_t size_bytes() const { return sizeof(_slots); }
+
+private:
+    struct slot_t {
+        alignas(T) unsigned char data[sizeof(T)];
+    };
+    slot_t _slots[N];
+    int    _used {0};
+};
+
+#endif // TUPP_USB_ENDPOINT_POOL_H
@@ -14,10 +14,36 @@
 // Implementation of a generic FIFO with fixed size.
 // The FIFO data type and size are the template parameters.
 //
+// The FIFO is lock-free for a single producer and a single
+// consumer (SPSC), which may run in different contexts, e.g.
+// the USB IRQ and the user program, or even on different CPU
+// cores. Only the producer modifies the put pointer, and only
+// the consumer modifies the get pointer. The data is published
+// with release/acquire semantics, so no interrupt has to be
+// disabled around the FIFO methods.
+// The producer may call put(), put_n(), reserve_write(),
+// commit_write() and available_put(), the consumer may call
+// get(), get_n(), peek_read(), consume(), available_get() and
+// clear().
+//
+// If SIZE is a power of two, a specialization is used, which
+// works with free-running index counters. The counters are
+// masked when accessing the buffer, and their difference is
+// the fill level, so no wrap-around checks are needed. This
+// version is able to store SIZE (instead of SIZE-1) elements.
+//
 #ifndef TUPP_USB_FIFO_H
 #define TUPP_USB_FIFO_H
 
-template<typename T, int SIZE>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+template<typename T, int SIZE,
+         bool POW2 = (SIZE > 0) && ((SIZE & (SIZE - 1)) == 0)>
 class fifo {
 public:
     fifo()
@@ -25,56 +51,342 @@ public:
       _get_ptr(_buffer),
       _put_ptr(_buffer) {}
 
+    // No copy, no assignment
+    fifo(const fifo &) = delete;
+    fifo & operator= (const fifo &) = delete;
+
     bool get(T & data) {
-        if (_get_ptr == _put_ptr) {
+        T * getptr = _get_ptr.load(std::memory_order_relaxed);
+        if (getptr == _put_ptr.load(std::memory_order_acquire)) {
             return false;
         }
-        T * nextget =  _get_ptr + 1;
+        T * nextget =  getptr + 1;
         if (nextget == _need_wrap) {
             nextget =  _buffer;
         }
-        data = *_get_ptr;
-        _get_ptr = nextget;
+        data = *getptr;
+        _get_ptr.store(nextget, std::memory_order_release);
         return true;
     }
 
     bool put(const T & data) {
-        T * nextput =  _put_ptr + 1;
+        T * putptr  = _put_ptr.load(std::memory_order_relaxed);
+        T * nextput =  putptr + 1;
         if (nextput == _need_wrap){
             nextput =  _buffer;
         }
-        if (nextput == _get_ptr) {
+        if (nextput == _get_ptr.load(std::memory_order_acquire)) {
             return false;
         } else {
-            *_put_ptr = data;
-             _put_ptr = nextput;
+            *putptr = data;
+            _put_ptr.store(nextput, std::memory_order_release);
         }
         return true;
     }
 
-    int available_get() volatile {
-        int res = _put_ptr - _get_ptr;
+    // Put up to n elements into the FIFO. The data is copied
+    // in at most two contiguous segments (before and after the
+    // wrap-around). Return the number of elements written.
+    int put_n(const T * data, int n) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T * putptr = _put_ptr.load(std::memory_order_relaxed);
+        int space  = _get_ptr.load(std::memory_order_acquire) - putptr - 1;
+        if (space < 0) {
+            space += SIZE;
+        }
+        if (n > space) n = space;
+        // First segment up to the end of the buffer
+        int first = _need_wrap - putptr;
+        if (first > n) first = n;
+        memcpy(putptr,  data,         first * sizeof(T));
+        memcpy(_buffer, data + first, (n - first) * sizeof(T));
+        putptr += n;
+        if (putptr >= _need_wrap) {
+            putptr -= SIZE;
+        }
+        _put_ptr.store(putptr, std::memory_order_release);
+        return n;
+    }
+
+    // Get up to n elements from the FIFO. The data is copied
+    // in at most two contiguous segments (before and after the
+    // wrap-around). Return the number of elements read.
+    int get_n(T * data, int n) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T * getptr = _get_ptr.load(std::memory_order_relaxed);
+        int avail  = _put_ptr.load(std::memory_order_acquire) - getptr;
+        if (avail < 0) {
+            avail += SIZE;
+        }
+        if (n > avail) n = avail;
+        // First segment up to the end of the buffer
+        int first = _need_wrap - getptr;
+        if (first > n) first = n;
+        memcpy(data,         getptr,  first * sizeof(T));
+        memcpy(data + first, _buffer, (n - first) * sizeof(T));
+        getptr += n;
+        if (getptr >= _need_wrap) {
+            getptr -= SIZE;
+        }
+        _get_ptr.store(getptr, std::memory_order_release);
+        return n;
+    }
+
+    // Zero-copy write access: Return a contiguous span of up to
+    // n free elements, which can be filled in place. The span
+    // might be shorter than n (FIFO full, or wrap-around reached).
+    // The data becomes visible to the consumer with commit_write().
+    std::span<T> reserve_write(int n) {
+        T * putptr = _put_ptr.load(std::memory_order_relaxed);
+        int space  = _get_ptr.load(std::memory_order_acquire) - putptr - 1;
+        if (space < 0) {
+            space += SIZE;
+        }
+        if (n > space) n = space;
+        if (n > _need_wrap - putptr) n = _need_wrap - putptr;
+        return { putptr, (size_t)n };
+    }
+
+    // Zero-copy write access like above, but the free space
+    // may wrap around, so it is returned in two spans. Return
+    // the total number of reserved elements (up to n).
+    int reserve_write(int n, std::span<T> & first, std::span<T> & second) {
+        T * putptr = _put_ptr.load(std::memory_order_relaxed);
+        int space  = _get_ptr.load(std::memory_order_acquire) - putptr - 1;
+        if (space < 0) {
+            space += SIZE;
+        }
+        if (n > space) n = space;
+        int len = _need_wrap - putptr;
+        if (len > n) len = n;
+        first  = { putptr,  (size_t)len };
+        second = { _buffer, (size_t)(n - len) };
+        return n;
+    }
+
+    // Publish n elements of a span returned by reserve_write()
+    void commit_write(int n) {
+        assert(n <= available_put());
+        T * putptr = _put_ptr.load(std::memory_order_relaxed) + n;
+        if (putptr >= _need_wrap) {
+            putptr -= SIZE;
+        }
+        _put_ptr.store(putptr, std::memory_order_release);
+    }
+
+    // Zero-copy read access: Return a contiguous span of all
+    // elements up to the wrap-around. The elements stay in the
+    // FIFO until they are released with consume().
+    std::span<T> peek_read() {
+        T * getptr = _get_ptr.load(std::memory_order_relaxed);
+        int avail  = _put_ptr.load(std::memory_order_acquire) - getptr;
+        if (avail < 0) {
+            avail += SIZE;
+        }
+        if (avail > _need_wrap - getptr) avail = _need_wrap - getptr;
+        return { getptr, (size_t)avail };
+    }
+
+    // Zero-copy read access to all elements, which are returned
+    // in two spans (before and after the wrap-around). The second
+    // span is empty if the data is contiguous. Return the total
+    // number of elements.
+    int peek_read(std::span<T> & first, std::span<T> & second) {
+        T * getptr = _get_ptr.load(std::memory_order_relaxed);
+        int avail  = _put_ptr.load(std::memory_order_acquire) - getptr;
+        if (avail < 0) {
+            avail += SIZE;
+        }
+        int len = _need_wrap - getptr;
+        if (len > avail) len = avail;
+        first  = { getptr,  (size_t)len };
+        second = { _buffer, (size_t)(avail - len) };
+        return avail;
+    }
+
+    // Release n elements of a span returned by peek_read()
+    void consume(int n) {
+        assert(n <= available_get());
+        T * getptr = _get_ptr.load(std::memory_order_relaxed) + n;
+        if (getptr >= _need_wrap) {
+            getptr -= SIZE;
+        }
+        _get_ptr.store(getptr, std::memory_order_release);
+    }
+
+    int available_get() const {
+        int res = _put_ptr.load(std::memory_order_acquire) -
+                  _get_ptr.load(std::memory_order_acquire);
         if (res < 0) {
             res += SIZE;
         }
         return res;
     }
 
-    int available_put() volatile {
+    int available_put() const {
         return SIZE - available_get() - 1;
     }
 
+    // Discard all data in the FIFO. This is done
+    // by the consumer, so the producer may still
+    // continue to put new data into the FIFO.
     void clear() {
-        _get_ptr = _buffer;
-        _put_ptr = _buffer;
+        _get_ptr.store(_put_ptr.load(std::memory_order_acquire),
+                       std::memory_order_release);
     }
 
 private:
 
     T   _buffer[SIZE] {};
     T * _need_wrap;
-    T * _get_ptr;
-    T * _put_ptr;
+    std::atomic<T *> _get_ptr;
+    std::atomic<T *> _put_ptr;
+};
+
+// Specialization for FIFO sizes which are a power of two
+template<typename T, int SIZE>
+class fifo<T, SIZE, true> {
+public:
+    fifo() : _get_idx(0), _put_idx(0) {}
+
+    // No copy, no assignment
+    fifo(const fifo &) = delete;
+    fifo & operator= (const fifo &) = delete;
+
+    bool get(T & data) {
+        index_t getidx = _get_idx.load(std::memory_order_relaxed);
+        if (getidx == _put_idx.load(std::memory_order_acquire)) {
+            return false;
+        }
+        data = _buffer[getidx & MASK];
+        _get_idx.store(getidx + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool put(const T & data) {
+        index_t putidx = _put_idx.load(std::memory_order_relaxed);
+        if ((index_t)(putidx - _get_idx.load(std::memory_order_acquire)) == SIZE) {
+            return false;
+        }
+        _buffer[putidx & MASK] = data;
+        _put_idx.store(putidx + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Put up to n elements into the FIFO. The data is copied
+    // in at most two contiguous segments (before and after the
+    // wrap-around). Return the number of elements written.
+    int put_n(const T * data, int n) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        index_t putidx = _put_idx.load(std::memory_order_relaxed);
+        int space = SIZE - (index_t)(putidx - _get_idx.load(std::memory_order_acquire));
+        if (n > space) n = space;
+        // First segment up to the end of the buffer
+        int pos   = putidx & MASK;
+        int first = SIZE - pos;
+        if (first > n) first = n;
+        memcpy(_buffer + pos, data,         first * sizeof(T));
+        memcpy(_buffer,       data + first, (n - first) * sizeof(T));
+        _put_idx.store(putidx + n, std::memory_order_release);
+        return n;
+    }
+
+    // Get up to n elements from the FIFO. The data is copied
+    // in at most two contiguous segments (before and after the
+    // wrap-around). Return the number of elements read.
+    int get_n(T * data, int n) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        index_t getidx = _get_idx.load(std::memory_order_relaxed);
+        int avail = (index_t)(_put_idx.load(std::memory_order_acquire) - getidx);
+        if (n > avail) n = avail;
+        // First segment up to the end of the buffer
+        int pos   = getidx & MASK;
+        int first = SIZE - pos;
+        if (first > n) first = n;
+        memcpy(data,         _buffer + pos, first * sizeof(T));
+        memcpy(data + first, _buffer,       (n - first) * sizeof(T));
+        _get_idx.store(getidx + n, std::memory_order_release);
+        return n;
+    }
+
+    // Zero-copy write access (see generic version above)
+    std::span<T> reserve_write(int n) {
+        index_t putidx = _put_idx.load(std::memory_order_relaxed);
+        int space = SIZE - (index_t)(putidx - _get_idx.load(std::memory_order_acquire));
+        int pos   = putidx & MASK;
+        if (n > space)      n = space;
+        if (n > SIZE - pos) n = SIZE - pos;
+        return { _buffer + pos, (size_t)n };
+    }
+
+    int reserve_write(int n, std::span<T> & first, std::span<T> & second) {
+        index_t putidx = _put_idx.load(std::memory_order_relaxed);
+        int space = SIZE - (index_t)(putidx - _get_idx.load(std::memory_order_acquire));
+        int pos   = putidx & MASK;
+        if (n > space) n = space;
+        int len = SIZE - pos;
+        if (len > n) len = n;
+        first  = { _buffer + pos, (size_t)len };
+        second = { _buffer,       (size_t)(n - len) };
+        return n;
+    }
+
+    void commit_write(int n) {
+        assert(n <= available_put());
+        _put_idx.store(_put_idx.load(std::memory_order_relaxed) + n,
+                       std::memory_order_release);
+    }
+
+    // Zero-copy read access (see generic version above)
+    std::span<T> peek_read() {
+        index_t getidx = _get_idx.load(std::memory_order_relaxed);
+        int avail = (index_t)(_put_idx.load(std::memory_order_acquire) - getidx);
+        int pos   = getidx & MASK;
+        if (avail > SIZE - pos) avail = SIZE - pos;
+        return { _buffer + pos, (size_t)avail };
+    }
+
+    int peek_read(std::span<T> & first, std::span<T> & second) {
+        index_t getidx = _get_idx.load(std::memory_order_relaxed);
+        int avail = (index_t)(_put_idx.load(std::memory_order_acquire) - getidx);
+        int pos   = getidx & MASK;
+        int len   = SIZE - pos;
+        if (len > avail) len = avail;
+        first  = { _buffer + pos, (size_t)len };
+        second = { _buffer,       (size_t)(avail - len) };
+        return avail;
+    }
+
+    void consume(int n) {
+        assert(n <= available_get());
+        _get_idx.store(_get_idx.load(std::memory_order_relaxed) + n,
+                       std::memory_order_release);
+    }
+
+    int available_get() const {
+        return (index_t)(_put_idx.load(std::memory_order_acquire) -
+                         _get_idx.load(std::memory_order_acquire));
+    }
+
+    int available_put() const {
+        return SIZE - available_get();
+    }
+
+    // Discard all data in the FIFO (consumer side)
+    void clear() {
+        _get_idx.store(_put_idx.load(std::memory_order_acquire),
+                       std::memory_order_release);
+    }
+
+private:
+    // The index counters need one more bit than the
+    // buffer index, so that a full FIFO can be detected.
+    using index_t = std::conditional_t<(SIZE <= 0x8000), uint16_t, uint32_t>;
+    static constexpr index_t MASK = SIZE - 1;
+
+    T   _buffer[SIZE] {};
+    std::atomic<index_t> _get_idx;
+    std::atomic<index_t> _put_idx;
 };
 
 #endif // TUPP_USB_FIFO_H
@@ -0,0 +1,117 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Copy routines for the data transfer between user
+// buffers and the HW buffers in USB RAM.
+//
+// Some platforms (e.g. RP2350) generate a hard fault after
+// an unaligned word/half-word access to the USB RAM. A plain
+// memcpy() might do such accesses, so the aligned versions
+// below access the USB RAM only with byte accesses (for the
+// unaligned head and tail) and aligned word accesses (for the
+// body, in bursts of 4 words). The user buffer is read/written
+// with memcpy() of single words, which results in the best
+// possible access for the platform. The USB RAM is accessed
+// through volatile pointers, so the compiler can neither merge
+// the accesses nor replace the loops by a memcpy() call.
+//
+#ifndef TUPP_USB_HW_COPY_H
+#define TUPP_USB_HW_COPY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "usb_config.h"
+
+// Copy n bytes from a user buffer to USB RAM
+inline void tupp_copy_to_hw_aligned(uint8_t * hw, const uint8_t * from, size_t n) {
+    volatile uint8_t * hw8 = hw;
+    // Unaligned head
+    while (n && ((uintptr_t)hw8 & 3)) {
+        *hw8++ = *from++;
+        n--;
+    }
+    // Aligned body
+    volatile uint32_t * hw32 = (volatile uint32_t *)hw8;
+    uint32_t w0, w1, w2, w3;
+    for (; n >= 16; n -= 16, from += 16, hw32 += 4) {
+        memcpy(&w0, from,      4);
+        memcpy(&w1, from + 4,  4);
+        memcpy(&w2, from + 8,  4);
+        memcpy(&w3, from + 12, 4);
+        hw32[0] = w0;
+        hw32[1] = w1;
+        hw32[2] = w2;
+        hw32[3] = w3;
+    }
+    for (; n >= 4; n -= 4, from += 4) {
+        memcpy(&w0, from, 4);
+        *hw32++ = w0;
+    }
+    // Tail
+    hw8 = (volatile uint8_t *)hw32;
+    while (n--) {
+        *hw8++ = *from++;
+    }
+}
+
+// Copy n bytes from USB RAM to a user buffer
+inline void tupp_copy_from_hw_aligned(uint8_t * to, const uint8_t * hw, size_t n) {
+    const volatile uint8_t * hw8 = hw;
+    // Unaligned head
+    while (n && ((uintptr_t)hw8 & 3)) {
+        *to++ = *hw8++;
+        n--;
+    }
+    // Aligned body
+    const volatile uint32_t * hw32 = (const volatile uint32_t *)hw8;
+    uint32_t w0, w1, w2, w3;
+    for (; n >= 16; n -= 16, to += 16, hw32 += 4) {
+        w0 = hw32[0];
+        w1 = hw32[1];
+        w2 = hw32[2];
+        w3 = hw32[3];
+        memcpy(to,      &w0, 4);
+        memcpy(to + 4,  &w1, 4);
+        memcpy(to + 8,  &w2, 4);
+        memcpy(to + 12, &w3, 4);
+    }
+    for (; n >= 4; n -= 4, to += 4) {
+        w0 = *hw32++;
+        memcpy(to, &w0, 4);
+    }
+    // Tail
+    hw8 = (const volatile uint8_t *)hw32;
+    while (n--) {
+        *to++ = *hw8++;
+    }
+}
+
+inline void tupp_copy_to_hw(uint8_t * hw, const uint8_t * from, size_t n) {
+#if (TUPP_USE_ALIGNED_MEMCPY)
+    tupp_copy_to_hw_aligned(hw, from, n);
+#else
+    memcpy(hw, from, n);
+#endif
+}
+
+inline void tupp_copy_from_hw(uint8_t * to, const uint8_t * hw, size_t n) {
+#if (TUPP_USE_ALIGNED_MEMCPY)
+    tupp_copy_from_hw_aligned(to, hw, n);
+#else
+    memcpy(to, hw, n);
+#endif
+}
+
+#endif // TUPP_USB_HW_COPY_H
@@ -26,7 +26,7 @@ using namespace TUPP;
 using enum usb_log::log_level;
 
 usb_interface::usb_interface(usb_configuration & conf)
-:  descriptor(_descriptor), _parent(conf), _descriptor{},
+:  descriptor(_descriptor), _parent(conf), _descriptor{}, _blob_offset(0),
   _assoc_ptr(nullptr), _fd_ptr(nullptr), _endpoints{nullptr}
 {
     TUPP_LOG(LOG_DEBUG, "usb_interface(conf) @%x", this);
@@ -39,7 +39,7 @@ usb_interface::usb_interface(usb_configuration & conf)
 }
 
 usb_interface::usb_interface(usb_interface_association & assoc)
-:  descriptor(_descriptor), _parent(assoc.get_parent()), _descriptor{},
+:  descriptor(_descriptor), _parent(assoc.get_parent()), _descriptor{}, _blob_offset(0),
   _assoc_ptr(nullptr), _fd_ptr(nullptr), _endpoints{nullptr}
 {
     TUPP_LOG(LOG_DEBUG, "usb_interface(assoc) @%x", this);
@@ -54,6 +54,11 @@ usb_interface::usb_interface(usb_interface_association & assoc)
 void usb_interface::set_InterfaceName(const char * s) {
     TUPP_LOG(LOG_DEBUG, "set_InterfaceName(%s)", s);
     _descriptor.iInterface = usb_strings::inst.add_string(s);
+    update_descriptor();
+}
+
+void usb_interface::patch_descriptor(uint16_t offset, const void * desc, uint8_t len) {
+    _parent.patch_descriptor(offset, desc, len);
 }
 
 void usb_interface::add_endpoint(usb_endpoint * ep) {
@@ -68,7 +73,7 @@ void usb_interface::add_endpoint(usb_endpoint * ep) {
     }
     assert(i != TUPP_MAX_EP_PER_INTERFACE);
     _descriptor.bNumEndpoints = i+1;
-    _parent.set_total_length();
+    _parent.add_total_length(ep->descriptor.bLength);
 }
 
 void usb_interface::add_func_descriptor(usb_fd_base * desc) {
@@ -83,7 +88,7 @@ void usb_interface::add_func_descriptor(usb_fd_base * desc) {
         // and link in this descriptor
         ptr->next = desc;
     }
-    _parent.set_total_length();
+    _parent.add_total_length(desc->descriptor_length);
 }
 
 uint16_t usb_interface::get_total_desc_length() {
@@ -112,37 +117,32 @@ void usb_interface::activate_endpoints(bool b) {
     }
 }
 
-uint16_t usb_interface::prepare_descriptor(uint8_t * buffer, uint16_t size) {
+uint16_t usb_interface::prepare_descriptor(uint8_t * blob, uint16_t offset) {
     TUPP_LOG(LOG_DEBUG, "prepare_descriptor()");
-    uint8_t * tmp_ptr = buffer;
+    uint16_t start = offset;
+    // Append one descriptor and remember its offset
+    auto append = [&](uint16_t & blob_offset, const void * desc, uint16_t len) {
+        assert(offset + len <= TUPP_MAX_DESC_SIZE);
+        memcpy(blob + offset, desc, len);
+        blob_offset = offset;
+        offset += len;
+    };
     // Process interface association
     if (_assoc_ptr) {
-        memcpy(tmp_ptr, &_assoc_ptr->descriptor, sizeof(interface_association_descriptor_t));
-        tmp_ptr += sizeof(interface_association_descriptor_t);
-        assert((tmp_ptr-buffer) <= size);
+        append(_assoc_ptr->_blob_offset, &_assoc_ptr->_descriptor,
+               sizeof(interface_association_descriptor_t));
     }
     // Process interface descriptor
-    memcpy(tmp_ptr, &_descriptor, sizeof(interface_descriptor_t));
-    tmp_ptr += sizeof(interface_descriptor_t);
-    assert((tmp_ptr-buffer) <= size);
+    append(_blob_offset, &_descriptor, sizeof(interface_descriptor_t));
     // Process functional descriptors
-    if (_fd_ptr) {
-        // Process Functional Descriptors
-        usb_fd_base * fd_ptr = _fd_ptr;
-        while(fd_ptr) {
-            memcpy(tmp_ptr, fd_ptr->descriptor, fd_ptr->descriptor_length);
-            tmp_ptr += fd_ptr->descriptor_length;
-            assert((tmp_ptr-buffer) <= size);
-            fd_ptr = fd_ptr->next;
-        }
+    for (usb_fd_base * fd = _fd_ptr; fd; fd = fd->next) {
+        append(fd->blob_offset, fd->descriptor, fd->descriptor_length);
     }
     // Process all endpoint descriptors
     for (auto ep : _endpoints) {
         if (ep) {
-            memcpy(tmp_ptr, &ep->descriptor, sizeof(endpoint_descriptor_t));
-            tmp_ptr += sizeof(endpoint_descriptor_t);
-            assert((tmp_ptr-buffer) <= size);
+            append(ep->_blob_offset, &ep->_descriptor, sizeof(endpoint_descriptor_t));
         }
     }
-    return tmp_ptr - buffer;
+    return offset - start;
 }
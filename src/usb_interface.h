@@ -15,11 +15,11 @@
 #define TUPP_USB_INTERFACE_H
 
 #include <array>
-#include <functional>
 
 #include "usb_structs.h"
 #include "usb_config.h"
 #include "usb_log.h"
+#include "usb_delegate.h"
 
 // Forward declarations (to prevent
 // mutual inclusions of header files)
@@ -48,25 +48,34 @@ public:
     inline void set_bInterfaceNumber(uint8_t n) {
         TUPP_LOG(LOG_DEBUG, "set_bInterfaceNumber(%d)", n);
         _descriptor.bInterfaceNumber = n;
+        update_descriptor();
     }
     inline void set_bAlternateSetting(uint8_t n) {
         TUPP_LOG(LOG_DEBUG, "set_bAlternateSetting(%d)", n);
         _descriptor.bAlternateSetting = n;
+        update_descriptor();
     }
     inline void set_bInterfaceClass(TUPP::bInterfaceClass_t n) {
         TUPP_LOG(LOG_DEBUG, "set_bInterfaceClass(%d)", n);
         _descriptor.bInterfaceClass = n;
+        update_descriptor();
     }
     inline void set_bInterfaceSubClass(TUPP::bInterfaceSubClass_t n) {
         TUPP_LOG(LOG_DEBUG, "set_bInterfaceSubClass(%d)", n);
         _descriptor.bInterfaceSubClass = n;
+        update_descriptor();
     }
     inline void set_bInterfaceProtocol(TUPP::bInterfaceProtocol_t n) {
         TUPP_LOG(LOG_DEBUG, "set_bInterfaceProtocol(%d)", n);
         _descriptor.bInterfaceProtocol = n;
+        update_descriptor();
     }
     void set_InterfaceName(const char * s);
 
+    // Copy a modified descriptor of this interface (e.g. of
+    // an endpoint) to the serialized configuration descriptor
+    void patch_descriptor(uint16_t offset, const void * desc, uint8_t len);
+
     // Add an endpoint to this interface
     void add_endpoint(usb_endpoint * ep);
 
@@ -83,21 +92,31 @@ public:
     // Read-only version of our descriptor
     const TUPP::interface_descriptor_t & descriptor;
 
-    // Prepare the complete configuration descriptor in a given
-    // buffer with given size. Return the size of the descriptor.
-    uint16_t prepare_descriptor(uint8_t * buffer, uint16_t size);
+    // Copy all descriptors of this interface (including an
+    // interface association, functional descriptors and endpoints)
+    // to the serialized configuration descriptor blob, starting
+    // at offset. Every descriptor remembers its offset, so it can
+    // be patched later. Return the number of copied bytes.
+    uint16_t prepare_descriptor(uint8_t * blob, uint16_t offset);
 
     // The setup message handler which handles all
     // commands directed to this interface. Will be
     // called by the usb_device_controller.
-    std::function<void(TUPP::setup_packet_t * packet)> setup_handler;
+    delegate<void(TUPP::setup_packet_t * packet)> setup_handler;
 
 private:
+    // Patch our own descriptor in the serialized descriptor
+    inline void update_descriptor() {
+        patch_descriptor(_blob_offset, &_descriptor, sizeof(_descriptor));
+    }
+
     // Reference to parent configuration object
     usb_configuration & _parent;
 
-    // The interface descriptor
+    // The interface descriptor and its offset
+    // in the serialized configuration descriptor
     TUPP::interface_descriptor_t _descriptor;
+    uint16_t _blob_offset;
 
     // Pointer to an interface association which
     // this interface belongs to. Only the first
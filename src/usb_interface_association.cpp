@@ -21,7 +21,7 @@ using namespace TUPP;
 using enum usb_log::log_level;
 
 usb_interface_association::usb_interface_association(usb_configuration & p)
-    : descriptor(_descriptor), _parent(p), _descriptor{}
+    : descriptor(_descriptor), _parent(p), _descriptor{}, _blob_offset(0)
 {
     TUPP_LOG(LOG_DEBUG, "usb_interface_association() @%x", this);
     // Set descriptor length
@@ -35,6 +35,7 @@ usb_interface_association::usb_interface_association(usb_configuration & p)
 void usb_interface_association::set_FunctionName(const char * n) {
     TUPP_LOG(LOG_DEBUG, "set_FunctionName(%s)", n);
     _descriptor.iFunction = usb_strings::inst.add_string(n);
+    update_descriptor();
 }
 
 void usb_interface_association::add_interface(usb_interface * interface) {
@@ -44,10 +45,20 @@ void usb_interface_association::add_interface(usb_interface * interface) {
     if (!descriptor.bInterfaceCount) {
         // First interface for this association, so store
         // the index in the descriptor and a pointer to
-        // this association in the interface.
+        // this association in the interface. Now our
+        // descriptor is part of the configuration.
         _descriptor.bFirstInterface = index;
         interface->_assoc_ptr = this;
+        _parent.add_total_length(sizeof(_descriptor));
     }
     // Increment the interface count in any case.
     _descriptor.bInterfaceCount++;
+    update_descriptor();
+}
+
+void usb_interface_association::update_descriptor() {
+    // Only an association in use is serialized
+    if (_descriptor.bInterfaceCount) {
+        _parent.patch_descriptor(_blob_offset, &_descriptor, sizeof(_descriptor));
+    }
 }
@@ -35,12 +35,15 @@ public:
     // Methods to set the descriptor elements
     inline void set_bFunctionClass(TUPP::bInterfaceClass_t n) {
         _descriptor.bFunctionClass = n;
+        update_descriptor();
     }
     inline void set_bFunctionSubClass(TUPP::bInterfaceSubClass_t  n) {
         _descriptor.bFunctionSubClass = n;
+        update_descriptor();
     }
     inline void set_bFunctionProtocol(TUPP::bInterfaceProtocol_t n) {
         _descriptor.bFunctionProtocol = n;
+        update_descriptor();
     }
     void set_FunctionName(const char *);
 
@@ -57,11 +60,19 @@ public:
     // Read-only version of our descriptor
     const TUPP::interface_association_descriptor_t & descriptor;
 
+    // Our friends
+    friend class usb_interface;     // serializes our descriptor
+
 private:
+    // Patch our descriptor in the serialized descriptor
+    void update_descriptor();
+
     usb_configuration & _parent;
 
-    // The interface association descriptor
+    // The interface association descriptor and its
+    // offset in the serialized configuration descriptor
     TUPP::interface_association_descriptor_t _descriptor;
+    uint16_t _blob_offset;
 };
 
 #endif  // TUPP_USB_INTERFACE_ASSOCIATION_H
@@ -0,0 +1,254 @@
+//    _   _             _    _  _____ ____
+//   | | (_)           | |  | |/ ____|  _ \   _     _
+//   | |_ _ _ __  _   _| |  | | (___ | |_) |_| |_ _| |_
+//   | __| | '_ \| | | | |  | |\___ \|  _ < _   _|_   _|
+//   | |_| | | | | |_| | |__| |____) | |_) | |_|   |_|
+//    \__|_|_| |_|\__, |\____/|_____/|____/
+//                __/ |
+//               |___/
+//
+// This file is part of tinyUSB++, C++ based and easy to
+// use library for USB host/device functionality.
+// (c) A. Terstegge  (Andreas.Terstegge@gmail.com)
+//
+// Compile-time generation of the USB descriptors. The
+// functions in this file are constexpr, so the descriptor
+// blobs are generated by the compiler and placed in flash
+// (when stored in constexpr variables). The lengths
+// (wTotalLength, bLength) and the numbers of interfaces,
+// endpoints and device capabilities are set automatically.
+// Example:
+//
+//   using namespace TUPP;
+//   constexpr auto dev  = STATIC::device({ .bcdUSB = 0x0200, ... });
+//   constexpr auto conf = STATIC::configuration(1, 0x80, 100, 0,
+//       STATIC::interface({ .bInterfaceClass = ... },
+//           STATIC::endpoint({ .bEndpointAddress = 0x81, ... }),
+//           STATIC::endpoint({ .bEndpointAddress = 0x01, ... })));
+//   constexpr auto str  = STATIC::strings(0x0409, "Maker", "Product");
+//   constexpr STATIC::descriptor_set descriptors(dev, conf, str);
+//
+// With TUPP_STATIC_DESCRIPTORS=1, the usb_device_controller
+// gets the descriptor_set in its CTOR and sends the blobs
+// without copying them. The usb_device/usb_configuration/
+// usb_interface objects are still needed for handling the
+// requests and endpoints, so the constant descriptors have
+// to match them (same interface numbers and endpoints).
+//
+#ifndef TUPP_USB_STATIC_DESCRIPTORS_H
+#define TUPP_USB_STATIC_DESCRIPTORS_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "usb_structs.h"
+
+namespace TUPP::STATIC {
+
+    // A descriptor (or a sequence of descriptors) as raw bytes
+    template<size_t N>
+    using blob = std::array<uint8_t, N>;
+
+    // A sequence of string descriptors (index 0 is the language id)
+    template<size_t N>
+    struct string_table {
+        blob<N> data;
+        uint8_t count;
+    };
+
+    constexpr uint8_t lo(uint16_t v) { return v & 0xff; }
+    constexpr uint8_t hi(uint16_t v) { return v >> 8;   }
+
+    // Concatenate descriptors, e.g. several configurations
+    template<size_t... N>
+    constexpr auto concat(const blob<N> &... parts) {
+        blob<(N + ... + 0)> res {};
+        size_t i = 0;
+        ((std::copy(parts.begin(), parts.end(), res.begin() + i), i += N), ...);
+        return res;
+    }
+
+    // Count the descriptors of a type in a sequence of descriptors
+    template<size_t N>
+    constexpr uint8_t count(const blob<N> & b, bDescriptorType_t type, bool alt0_only = false) {
+        uint8_t n = 0;
+        for (size_t i=0; i < N; i += b[i]) {
+            if (b[i+1] == (uint8_t)type && (!alt0_only || !b[i+3])) ++n;
+        }
+        return n;
+    }
+
+    // Any other descriptor, e.g. a CDC functional descriptor
+    template<typename... T>
+    constexpr auto descriptor(uint8_t type, T... data) {
+        static_assert(sizeof...(T) <= 253);
+        return blob<sizeof...(T) + 2> { sizeof...(T) + 2, type, (uint8_t)data... };
+    }
+
+    constexpr auto device(const device_descriptor_t & d) {
+        return blob<sizeof(device_descriptor_t)> {
+            sizeof(device_descriptor_t), (uint8_t)bDescriptorType_t::DESC_DEVICE,
+            lo(d.bcdUSB), hi(d.bcdUSB), (uint8_t)d.bDeviceClass,
+            d.bDeviceSubClass, d.bDeviceProtocol, d.bMaxPacketSize0,
+            lo(d.idVendor), hi(d.idVendor), lo(d.idProduct), hi(d.idProduct),
+            lo(d.bcdDevice), hi(d.bcdDevice), d.iManufacturer, d.iProduct,
+            d.iSerialNumber, d.bNumConfigurations
+        };
+    }
+
+    // A configuration with all its interface (association) descriptors.
+    // bNumInterfaces is the number of interfaces with alternate setting 0.
+    // max_power_mA is limited to 510 mA (bMaxPower is in units of 2 mA).
+    template<size_t... N>
+    constexpr auto configuration(uint8_t bConfigurationValue, uint8_t bmAttributes,
+                                 uint16_t max_power_mA, uint8_t iConfiguration,
+                                 const blob<N> &... children) {
+        constexpr size_t len = sizeof(configuration_descriptor_t) + (N + ... + 0);
+        static_assert(len <= 0xffff);
+        assert(max_power_mA <= 510);
+        max_power_mA = std::min<uint16_t>(max_power_mA, 510);
+        auto body = concat(children...);
+        blob<sizeof(configuration_descriptor_t)> head {
+            sizeof(configuration_descriptor_t), (uint8_t)bDescriptorType_t::DESC_CONFIGURATION,
+            lo(len), hi(len), count(body, bDescriptorType_t::DESC_INTERFACE, true),
+            bConfigurationValue, iConfiguration, bmAttributes, (uint8_t)(max_power_mA / 2)
+        };
+        return concat(head, body);
+    }
+
+    constexpr auto association(const interface_association_descriptor_t & d) {
+        return blob<sizeof(interface_association_descriptor_t)> {
+            sizeof(interface_association_descriptor_t),
+            (uint8_t)bDescriptorType_t::DESC_INTERFACE_ASSOCIATION,
+            d.bFirstInterface, d.bInterfaceCount, (uint8_t)d.bFunctionClass,
+            (uint8_t)d.bFunctionSubClass, (uint8_t)d.bFunctionProtocol, d.iFunction
+        };
+    }
+
+    // An interface with its functional and endpoint descriptors.
+    // bNumEndpoints is set automatically.
+    template<size_t... N>
+    constexpr auto interface(const interface_descriptor_t & d, const blob<N> &... children) {
+        auto body = concat(children...);
+        blob<sizeof(interface_descriptor_t)> head {
+            sizeof(interface_descriptor_t), (uint8_t)bDescriptorType_t::DESC_INTERFACE,
+            d.bInterfaceNumber, d.bAlternateSetting,
+            count(body, bDescriptorType_t::DESC_ENDPOINT), (uint8_t)d.bInterfaceClass,
+            (uint8_t)d.bInterfaceSubClass, (uint8_t)d.bInterfaceProtocol, d.iInterface
+        };
+        return concat(head, body);
+    }
+
+    constexpr auto endpoint(const endpoint_descriptor_t & d) {
+        return blob<sizeof(endpoint_descriptor_t)> {
+            sizeof(endpoint_descriptor_t), (uint8_t)bDescriptorType_t::DESC_ENDPOINT,
+            d.bEndpointAddress, (uint8_t)d.bmAttributes,
+            lo(d.wMaxPacketSize), hi(d.wMaxPacketSize), d.bInterval
+        };
+    }
+
+    // A string descriptor (ASCII string, which is stored as UTF16LE)
+    template<size_t N>
+    constexpr auto string(const char (&str)[N]) {
+        static_assert(N <= 127, "String too long");
+        blob<2 * N> res {};
+        res[0] = 2 * N;
+        res[1] = (uint8_t)bDescriptorType_t::DESC_STRING;
+        for (size_t i=0; i < N-1; ++i) res[2 + 2*i] = str[i];
+        return res;
+    }
+
+    // All string descriptors of a device. The strings have the
+    // indices 1, 2, ... in the order of the parameters.
+    template<size_t... N>
+    constexpr auto strings(uint16_t language_id, const char (&... str)[N]) {
+        auto data = concat(blob<4> { 4, (uint8_t)bDescriptorType_t::DESC_STRING,
+                                     lo(language_id), hi(language_id) }, string(str)...);
+        return string_table<std::tuple_size_v<decltype(data)>> { data, sizeof...(N) + 1 };
+    }
+
+    // A device capability descriptor for the BOS
+    template<typename... T>
+    constexpr auto capability(bDevCapabilityType_t type, T... data) {
+        return descriptor((uint8_t)bDescriptorType_t::DESC_DEVICE_CAPABILITY,
+                          (uint8_t)type, data...);
+    }
+
+    // A BOS descriptor with all its device capabilities
+    template<size_t... N>
+    constexpr auto bos(const blob<N> &... caps) {
+        constexpr size_t len = sizeof(bos_descriptor_t) + (N + ... + 0);
+        static_assert(len <= 0xffff);
+        blob<sizeof(bos_descriptor_t)> head {
+            sizeof(bos_descriptor_t), (uint8_t)bDescriptorType_t::DESC_BOS,
+            lo(len), hi(len), sizeof...(N)
+        };
+        return concat(head, caps...);
+    }
+
+    // The complete set of descriptors of a device, which
+    // is passed to the usb_device_controller. It only stores
+    // pointers to the blobs, which have to be constexpr
+    // variables with static storage duration.
+    class descriptor_set {
+    public:
+        template<size_t D, size_t C, size_t S>
+        constexpr descriptor_set(const blob<D> & dev, const blob<C> & confs,
+                                 const string_table<S> & strings)
+        : _device(dev.data()), _configurations(confs.data()),
+          _strings(strings.data.data()), _string_count(strings.count), _bos(nullptr) {
+            static_assert(D == sizeof(device_descriptor_t));
+        }
+
+        template<size_t D, size_t C, size_t S, size_t B>
+        constexpr descriptor_set(const blob<D> & dev, const blob<C> & confs,
+                                 const string_table<S> & strings, const blob<B> & bos)
+        : descriptor_set(dev, confs, strings) {
+            _bos = bos.data();
+        }
+
+        // The total length of a descriptor
+        static inline uint16_t length(const uint8_t * desc) {
+            auto type = (bDescriptorType_t)desc[1];
+            if (type == bDescriptorType_t::DESC_CONFIGURATION ||
+                type == bDescriptorType_t::DESC_BOS) {
+                return desc[2] | (desc[3] << 8);
+            }
+            return desc[0];
+        }
+
+        // Getters for the single descriptors. They return
+        // nullptr if the requested descriptor does not exist.
+        inline const uint8_t * device() const {
+            return _device;
+        }
+        inline const uint8_t * configuration(uint8_t index) const {
+            if (index >= _device[17]) return nullptr;
+            const uint8_t * desc = _configurations;
+            while (index--) desc += length(desc);
+            return desc;
+        }
+        inline const uint8_t * string(uint8_t index) const {
+            if (index >= _string_count) return nullptr;
+            const uint8_t * desc = _strings;
+            while (index--) desc += desc[0];
+            return desc;
+        }
+        inline const uint8_t * bos() const {
+            return _bos;
+        }
+
+    private:
+        const uint8_t * _device;
+        const uint8_t * _configurations;
+        const uint8_t * _strings;
+        uint8_t         _string_count;
+        const uint8_t * _bos;
+    };
+
+} // namespace TUPP::STATIC
+
+#endif  // TUPP_USB_STATIC_DESCRIPTORS_H